@@ -11,11 +11,12 @@ typedef int64_t velox_sample_t;
 class VeloxOptimizer
 {
 public:
-    static bool IsSilence(const std::vector<velox_sample_t> &block, int threshold = 0)
+    template <class T>
+    static bool IsSilence(const std::vector<T> &block, int threshold = 0)
     {
         for (auto s : block)
         {
-            if (std::abs(s) > threshold)
+            if (std::abs((int64_t)s) > threshold)
                 return false;
         }
         return true;
@@ -9,6 +9,11 @@
 
 typedef int64_t velox_sample_t;
 
+// Stream layout revisions (VeloxHeader::version)
+#define VELOX_VERSION_LEGACY 0x0800  // Stereo chunks bit-packed behind the stream prefix
+#define VELOX_VERSION_FRAMED 0x0900  // Byte-aligned, self-describing N-channel chunks
+#define VELOX_VERSION VELOX_VERSION_FRAMED
+
 #pragma pack(push, 1)
 struct VeloxHeader
 {
@@ -21,17 +26,55 @@ struct VeloxHeader
     uint64_t total_samples;
     uint32_t header_blob_size;
     uint32_t footer_blob_size;
-    uint32_t seek_table_offset; // Seek table start position
+    uint32_t seek_table_offset; // Seek table start position (file offset, 0 = none)
     uint32_t seek_table_count;  // Number of seek points
 };
 
+// One entry per chunk (version 0x0900+), stored after the compressed data
 struct VeloxSeekPoint
 {
     uint64_t sample_offset; // Sample index (e.g., 48000, 96000...)
-    uint64_t byte_offset;   // Byte offset in file
+    uint64_t byte_offset;   // Byte offset in file of the chunk's size prefix
+};
+
+// Encoders that cannot rewind (piped input or output) set footer_blob_size to
+// VELOX_BLOB_TRAILING. The chunks then end with a zero-size chunk, followed by
+// the seek table, the footer blob and this trailer as the last bytes of the
+// file. The header's total_samples is VELOX_SAMPLES_UNKNOWN and its seek table
+// fields are 0 unless the encoder could still patch them.
+struct VeloxTrailer
+{
+    uint32_t magic; // VELOX_TRAILER_MAGIC
+    uint64_t total_samples;
+    uint32_t footer_blob_size;
+    uint32_t seek_table_count;
 };
 #pragma pack(pop)
 
+#define VELOX_BLOB_TRAILING 0xFFFFFFFFu
+#define VELOX_SAMPLES_UNKNOWN 0xFFFFFFFFFFFFFFFFull
+#define VELOX_TRAILER_MAGIC 0x544C4556 // "VELT"
+
+// Reads the trailer off the end of a whole file image
+static inline bool ReadVeloxTrailer(const uint8_t *file, size_t size, VeloxTrailer &t)
+{
+    if (size < sizeof(VeloxTrailer))
+        return false;
+    memcpy(&t, file + size - sizeof(VeloxTrailer), sizeof(VeloxTrailer));
+    uint64_t tail = sizeof(VeloxTrailer) + (uint64_t)t.footer_blob_size + (uint64_t)t.seek_table_count * sizeof(VeloxSeekPoint);
+    return t.magic == VELOX_TRAILER_MAGIC && tail <= size;
+}
+
+// Offsets of the footer blob and the seek table a trailer describes
+static inline uint64_t VeloxTrailerFooterOffset(size_t size, const VeloxTrailer &t)
+{
+    return size - sizeof(VeloxTrailer) - t.footer_blob_size;
+}
+static inline uint64_t VeloxTrailerTableOffset(size_t size, const VeloxTrailer &t)
+{
+    return VeloxTrailerFooterOffset(size, t) - (uint64_t)t.seek_table_count * sizeof(VeloxSeekPoint);
+}
+
 // Fixed Point Math
 #define FX_SHIFT 12
 #define FX_ONE (1 << FX_SHIFT)
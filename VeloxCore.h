@@ -5,54 +5,181 @@
 #include "VeloxAdvanced.h"
 #include "VeloxEntropy.h"
 #include "VeloxThreads.h"
+#include "VeloxSIMD.h"
 #include <numeric>
-#include <future>
+#include <memory>
+#include <functional>
+#include <chrono>
 #include <vector>
 #include <cmath>
 #include <cstring>
 #include <algorithm>
 
 // --- NEURAL PREDICTOR ---
+// Sign-sign LMS over the last ORDER residuals. The history is a doubled
+// circular buffer (each value stored at k and k+ORDER), so the newest ORDER
+// values are always contiguous at hist+pos and inserting never shifts.
 class NeuralPredictor {
     static const int ORDER = 12;
-    int32_t weights[ORDER];
-    int32_t history[ORDER];
+    alignas(16) int32_t weights[ORDER];
+    alignas(16) int32_t hist[2 * ORDER];
+    int pos = 0; // hist[pos + i] is the i-th most recent value
 public:
-    NeuralPredictor() { memset(weights,0,sizeof(weights)); memset(history,0,sizeof(history)); }
-    inline int32_t Predict() {
+    NeuralPredictor() { memset(weights,0,sizeof(weights)); memset(hist,0,sizeof(hist)); }
+    inline int32_t Predict() const {
+        const int32_t* h = hist + pos;
         int64_t sum = 0;
-        for(int i=0; i<ORDER; i++) sum += (int64_t)history[i] * weights[i];
+        for(int i=0; i<ORDER; i++) sum += (int64_t)h[i] * weights[i];
         return (int32_t)(sum >> 11);
     }
     inline void Update(int32_t actual, int32_t pred) {
         int32_t err = actual - pred;
-        int sign = (err > 0) ? 1 : ((err < 0) ? -1 : 0);
-        if(sign == 0) return;
-        int delta = (std::abs(err) > 1024) ? 16 : 4; 
-        for(int i=0; i<ORDER; i++) {
-            int h_sign = (history[i]>0)?1:((history[i]<0)?-1:0);
-            if(sign == h_sign) weights[i] += delta;
-            else if(h_sign != 0) weights[i] -= delta;
-            if((i & 7) == 0) { if(weights[i]>0) weights[i]--; if(weights[i]<0) weights[i]++; }
-        }
-        for(int i=ORDER-1; i>0; i--) history[i] = history[i-1];
-        history[0] = actual;
+        if(err == 0) return;
+        // +delta where the history sign matches the error sign, -delta where
+        // it differs, nothing for zero history
+        int32_t step = (std::abs(err) > 1024) ? 16 : 4;
+        if(err < 0) step = -step;
+        const int32_t* h = hist + pos;
+#if VELOX_SIMD_X86
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i d = _mm_set1_epi32(step);
+        const __m128i decay = _mm_setr_epi32(-1, 0, 0, 0);
+        for(int i=0; i<ORDER; i+=4) {
+            __m128i hv = _mm_loadu_si128((const __m128i*)(h + i));
+            __m128i w = _mm_load_si128((const __m128i*)(weights + i));
+            w = _mm_add_epi32(w, _mm_sub_epi32(_mm_and_si128(d, _mm_cmpgt_epi32(hv, zero)),
+                                               _mm_and_si128(d, _mm_cmpgt_epi32(zero, hv))));
+            if((i & 7) == 0) { // Taps 0 and 8 decay toward zero
+                __m128i sgn = _mm_sub_epi32(_mm_cmpgt_epi32(zero, w), _mm_cmpgt_epi32(w, zero));
+                w = _mm_sub_epi32(w, _mm_and_si128(sgn, decay));
+            }
+            _mm_store_si128((__m128i*)(weights + i), w);
+        }
+#else
+        for(int i=0; i<ORDER; i++) weights[i] += step * ((h[i] > 0) - (h[i] < 0));
+        for(int i=0; i<ORDER; i+=8) weights[i] -= (weights[i] > 0) - (weights[i] < 0);
+#endif
+        pos = (pos == 0) ? ORDER - 1 : pos - 1;
+        hist[pos] = hist[pos + ORDER] = actual;
     }
 };
 
 class VeloxCodec {
-    static void ComputeLPC(const std::vector<velox_sample_t>& data, int order, std::vector<int>& coeffs, int& shift) {
-        if(data.empty()) return;
-        double autocorr[13];
+public:
+    // Encoder presets. Fast drops the neural stage and replaces the LPC
+    // autocorrelation with fixed polynomial predictors; Default is the
+    // classic order-8 + neural coder; Max searches LPC orders, chunk sizes
+    // and stereo modes (any VELOX_VERSION_FRAMED decoder reads all of them).
+    enum class Level { Fast, Default, Max };
+    static constexpr int MAX_LPC_ORDER = 32;
+
+    // --- STATISTICS ---
+    // Counters for one stream, filled by a StreamEncoder or StreamingDecoder
+    // after CollectStats(). Channel coders are instantiated with and without
+    // collection, so streams that don't collect pay one null check per chunk.
+    struct Stats {
+        uint64_t chunks = 0;
+        uint64_t samples = 0;
+        uint64_t bytes = 0; // Chunk payloads, framing excluded
+        uint64_t raw_chunks = 0; // Stored verbatim (WriteRawBlock fallback)
+        uint64_t high_res_chunks = 0;
+        uint64_t stereo[4] = {}; // Stereo chunks per StereoMode (L/R, M/S, L/S, R/S)
+        uint64_t channels = 0; // Channel blocks in compressed chunks
+        uint64_t silent_channels = 0; // VeloxOptimizer::IsSilence hits
+        uint64_t neural_channels = 0;
+        uint64_t lsb_shift[32] = {}; // Channel blocks per LSB shift
+        uint64_t lpc_order[MAX_LPC_ORDER + 1] = {}; // Non-silent channel blocks per predictor order
+        uint64_t rice_k[64] = {}; // Residuals per Rice parameter
+        uint64_t escapes = 0; // Residuals past the unary limit, stored in 40 bits
+        double analysis_seconds = 0; // Stereo decisions and Max planning, summed over workers
+        double coding_seconds = 0; // Channel coding and decoding, summed over workers
+
+        void Merge(const Stats& o) {
+            chunks += o.chunks; samples += o.samples; bytes += o.bytes;
+            raw_chunks += o.raw_chunks; high_res_chunks += o.high_res_chunks;
+            for (int i = 0; i < 4; i++) stereo[i] += o.stereo[i];
+            channels += o.channels; silent_channels += o.silent_channels; neural_channels += o.neural_channels;
+            for (int i = 0; i < 32; i++) lsb_shift[i] += o.lsb_shift[i];
+            for (int i = 0; i <= MAX_LPC_ORDER; i++) lpc_order[i] += o.lpc_order[i];
+            for (int i = 0; i < 64; i++) rice_k[i] += o.rice_k[i];
+            escapes += o.escapes;
+            analysis_seconds += o.analysis_seconds; coding_seconds += o.coding_seconds;
+        }
+
+        // Chunk-level counters shared by the encoder and the decoder
+        void CountChunk(uint32_t count, size_t size, bool raw, bool high_res, int stereoMode, size_t C) {
+            chunks++; samples += count; bytes += size;
+            raw_chunks += raw; high_res_chunks += high_res;
+            if (C == 2) stereo[stereoMode & 3]++;
+        }
+
+        // Channel header counters (silent channels only count as silent)
+        void CountChannel(bool silent, int lsb, int order, bool neural) {
+            channels++;
+            if (silent) { silent_channels++; return; }
+            lsb_shift[lsb & 31]++;
+            lpc_order[std::min(order, MAX_LPC_ORDER)]++;
+            neural_channels += neural;
+        }
+
+        void CountResidual(uint64_t zigzag, int k) {
+            rice_k[k & 63]++;
+            escapes += (zigzag >> k) >= 64;
+        }
+    };
+
+    static double SecondsSince(std::chrono::steady_clock::time_point t0) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+private:
+    // How one channel is predicted. order < 0 picks the cheapest fixed
+    // polynomial predictor (orders 0-3) instead of autocorrelation LPC.
+    struct ChannelCoding {
+        int order;
+        bool neural;
+    };
+
+    // Stereo decorrelation (2 bits, 1 bit in VELOX_VERSION_LEGACY streams)
+    enum StereoMode { STEREO_LR = 0, STEREO_MS = 1, STEREO_LS = 2, STEREO_RS = 3 };
+
+    typedef double LPCTable[MAX_LPC_ORDER + 1][MAX_LPC_ORDER + 1];
+
+    template<class T>
+    static void Autocorrelate(const std::vector<T>& data, int maxOrder, double* autocorr) {
         int stride = (data.size() > 4096) ? 4 : 1; 
-        for (int i = 0; i <= order; ++i) {
+        for (int i = 0; i <= maxOrder; ++i) {
             double sum = 0;
             for (size_t j = i; j < data.size(); j+=stride) sum += (double)data[j] * data[j - i];
             autocorr[i] = sum;
         }
-        if(std::abs(autocorr[0]) < 1e-9) { shift=0; coeffs.assign(order, 0); return; }
-        double a[13][13] = {0}; double e[13] = {0}; e[0] = autocorr[0];
-        for (int i = 1; i <= order; ++i) {
+    }
+
+    // Same sums with four independent accumulators per lag, so the adds
+    // pipeline. Rounding differs slightly, so it only feeds estimates.
+    // 'x' receives the samples as doubles.
+    template<class T>
+    static void AutocorrelateFast(const std::vector<T>& data, int maxOrder, double* autocorr, std::vector<double>& x) {
+        size_t n = data.size();
+        x.assign(data.begin(), data.end());
+        for (int i = 0; i <= maxOrder; ++i) {
+            double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+            size_t j = i;
+            for (; j + 4 <= n; j += 4) {
+                s0 += x[j] * x[j - i]; s1 += x[j + 1] * x[j + 1 - i];
+                s2 += x[j + 2] * x[j + 2 - i]; s3 += x[j + 3] * x[j + 3 - i];
+            }
+            for (; j < n; j++) s0 += x[j] * x[j - i];
+            autocorr[i] = (s0 + s1) + (s2 + s3);
+        }
+    }
+
+    // Levinson-Durbin up to maxOrder. a[j][p] is tap j of the order-p
+    // predictor and e[p] its residual energy. Returns false for a silent block.
+    static bool Levinson(const double* autocorr, int maxOrder, LPCTable& a, double* e) {
+        if(std::abs(autocorr[0]) < 1e-9) return false;
+        e[0] = autocorr[0];
+        for (int i = 1; i <= maxOrder; ++i) {
             double k = autocorr[i];
             for (int j = 1; j < i; ++j) k -= a[j][i - 1] * autocorr[i - j];
             k /= e[i - 1];
@@ -61,49 +188,135 @@ class VeloxCodec {
             for (int j = 1; j < i; ++j) a[j][i] = a[j][i - 1] - k * a[i - j][i - 1];
             e[i] = e[i - 1] * (1 - k * k);
         }
+        return true;
+    }
+
+    static void QuantizeLPC(const LPCTable& a, int order, std::vector<int>& coeffs, int& shift) {
         shift = 11; coeffs.resize(order);
-        for (int i = 1; i <= order; ++i) coeffs[i-1] = (int)std::floor(a[i][order] * (1 << shift) + 0.5);
+        for (int i = 1; i <= order; ++i) {
+            double c = std::floor(a[i][order] * (1 << shift) + 0.5);
+            coeffs[i-1] = (int)std::max(-32768.0, std::min(32767.0, c)); // Stored as 16 bits
+        }
     }
 
-    // --- WORKER: Try Compress ---
-    static void TryCompressChannel(const std::vector<velox_sample_t>& input_data, BitStreamWriter& bs, bool high_res_mode) {
-        std::vector<velox_sample_t> work_data = input_data;
+    template<class T>
+    static void ComputeLPC(const std::vector<T>& data, int order, std::vector<int>& coeffs, int& shift) {
+        if(data.empty()) return;
+        double autocorr[MAX_LPC_ORDER + 1];
+        Autocorrelate(data, order, autocorr);
+        LPCTable a = {{0}}; double e[MAX_LPC_ORDER + 1] = {0};
+        if(!Levinson(autocorr, order, a, e)) { shift=0; coeffs.assign(order, 0); return; }
+        QuantizeLPC(a, order, coeffs, shift);
+    }
+
+    // Fixed polynomial predictors (no autocorrelation): picks the order 0-3
+    // with the smallest absolute residual sum. Coefficients use shift 0.
+    template<class T>
+    static void ComputeFixed(const std::vector<T>& data, std::vector<int>& coeffs, int& shift) {
+        uint64_t cost[4] = {0, 0, 0, 0};
+        int64_t p1 = 0, p2 = 0, p3 = 0;
+        for (int64_t x : data) {
+            int64_t e1 = x - p1, e2 = e1 - (p1 - p2), e3 = e2 - (p1 - 2 * p2 + p3);
+            cost[0] += std::abs(x); cost[1] += std::abs(e1); cost[2] += std::abs(e2); cost[3] += std::abs(e3);
+            p3 = p2; p2 = p1; p1 = x;
+        }
+        static const int fixed[4][3] = {{0, 0, 0}, {1, 0, 0}, {2, -1, 0}, {3, -3, 1}};
+        int best = (int)(std::min_element(cost, cost + 4) - cost);
+        coeffs.assign(fixed[best], fixed[best] + best);
+        shift = 0;
+    }
+
+    // Per-thread working buffers of the chunk encoder. They grow to the
+    // largest chunk a thread has coded and are reused after that, so
+    // steady-state encoding does not allocate for them. One set per sample
+    // type (see EncodeSpan).
+    template<class T>
+    struct EncodeScratch {
+        std::vector<std::vector<T>> chans; // EncodeChunk
+        std::vector<T> tail;
+        std::vector<ChannelCoding> codings;
+        std::vector<T> work; // CompressChannel, EstimateChannel
+        std::vector<T> mid, side; // EncodeChunk, PlanChunk
+        std::vector<double> real; // EstimateChannel
         std::vector<uint8_t> low_bits;
+        std::vector<int> coeffs;
+        std::vector<int64_t> sums;
+        std::vector<velox_sample_t> wide; // EncodeSpan, 32-bit spans out of range
+    };
+    template<class T>
+    static EncodeScratch<T>& Scratch() { static thread_local EncodeScratch<T> scratch; return scratch; }
+
+    // LPC sums kernel for a work buffer: 32-bit buffers always take the
+    // vector kernels, 64-bit ones only when every sample fits in 32 bits
+    static LPCKernels::Sums32Fn SumsKernel(const std::vector<int32_t>&) { return LPCKernels::Get().sums32; }
+    static LPCKernels::SumsFn SumsKernel(const std::vector<velox_sample_t>& data) {
+        bool fits32 = std::all_of(data.begin(), data.end(),
+            [](velox_sample_t v) { return v >= INT32_MIN && v <= INT32_MAX; });
+        return (fits32 ? LPCKernels::Get() : LPCKernels::Scalar()).sums;
+    }
+
+    // --- WORKER: Try Compress ---
+    template<class T>
+    static void TryCompressChannel(const std::vector<T>& input_data, BitStreamWriter& bs, bool high_res_mode,
+                                   ChannelCoding coding, Stats* stats = nullptr) {
+        if (stats) CompressChannel<true>(input_data, bs, high_res_mode, coding, stats);
+        else CompressChannel<false>(input_data, bs, high_res_mode, coding, nullptr);
+    }
+
+    template<bool Collect, class T>
+    static void CompressChannel(const std::vector<T>& input_data, BitStreamWriter& bs, bool high_res_mode,
+                                ChannelCoding coding, Stats* stats) {
+        EncodeScratch<T>& scratch = Scratch<T>();
+        std::vector<T>& work_data = scratch.work;
+        std::vector<uint8_t>& low_bits = scratch.low_bits;
+        work_data.assign(input_data.begin(), input_data.end());
+        low_bits.clear();
         
         if (high_res_mode) {
-            low_bits.reserve(work_data.size());
             for(auto& val : work_data) {
                 low_bits.push_back((uint8_t)(val & 0xFF));
                 val >>= 8;
             }
         }
 
-        if (VeloxOptimizer::IsSilence(work_data)) { bs.Write(1, 1); return; }
+        if (VeloxOptimizer::IsSilence(work_data)) {
+            if constexpr (Collect) stats->CountChannel(true, 0, 0, false);
+            bs.Write(1, 1);
+            return;
+        }
         bs.Write(0, 1);
 
         int shift_lsb = LSBShifter::Analyze(work_data);
         LSBShifter::Apply(work_data, shift_lsb);
         bs.Write(shift_lsb, 5);
 
-        int order = 8; int lpc_shift = 0;
-        std::vector<int> lpc_coeffs;
-        ComputeLPC(work_data, order, lpc_coeffs, lpc_shift);
+        int lpc_shift = 0;
+        std::vector<int>& lpc_coeffs = scratch.coeffs;
+        lpc_coeffs.clear();
+        if (coding.order < 0) ComputeFixed(work_data, lpc_coeffs, lpc_shift);
+        else ComputeLPC(work_data, coding.order, lpc_coeffs, lpc_shift);
+        int order = (int)lpc_coeffs.size();
+        bs.Write(order, 6);
         bs.Write(lpc_shift, 5);
         for(int c : lpc_coeffs) bs.Write(c & 0xFFFF, 16);
+        bool use_neural = coding.neural;
+        bs.Write(use_neural, 1);
+        if constexpr (Collect) stats->CountChannel(false, shift_lsb, order, use_neural);
+
+        // LPC sums for the whole block up front (vectorized across samples)
+        std::vector<int64_t>& lpc_sums = scratch.sums;
+        lpc_sums.resize(work_data.size());
+        SumsKernel(work_data)(work_data.data(), work_data.size(), lpc_coeffs.data(), order, lpc_sums.data());
 
         NeuralPredictor neural;
         
         uint64_t run_avg = 512; 
 
         for(size_t i=0; i<work_data.size(); i++) {
-            velox_sample_t original = work_data[i];
-            int64_t sum = 0;
-            for(int j=0; j<order; j++) {
-                if(i > (size_t)j) sum += (int64_t)lpc_coeffs[j] * work_data[i-1-j];
-            }
-            int32_t predLPC = (int32_t)(sum >> lpc_shift);
+            int64_t original = work_data[i];
+            int32_t predLPC = (int32_t)(lpc_sums[i] >> lpc_shift);
             int64_t resLPC = original - predLPC; // Int64 to prevent any overflow
-            int32_t predNeural = neural.Predict();
+            int32_t predNeural = use_neural ? neural.Predict() : 0;
             int64_t finalRes = resLPC - predNeural;
 
             int k = 0;
@@ -114,9 +327,10 @@ class VeloxCodec {
             }
             VeloxEntropy::EncodeSample(bs, finalRes, k);
 
-            neural.Update(resLPC, predNeural);
+            if (use_neural) neural.Update(resLPC, predNeural);
             
             uint64_t m = VeloxEntropy::ZigZag(finalRes);
+            if constexpr (Collect) stats->CountResidual(m, k);
             run_avg = run_avg - (run_avg>>3) + (m>>3);
             if(run_avg < 1) run_avg = 1;
         }
@@ -127,16 +341,32 @@ class VeloxCodec {
     }
 
     // --- WORKER: Decompress ---
-    static void DecodeChannelWorker(BitStreamReader& bs, size_t count, std::vector<velox_sample_t>& out, bool high_res_mode) {
-        out.resize(count);
+    // 'tunable' channels (VELOX_VERSION_FRAMED) store the LPC order and the
+    // neural flag; legacy ones are always order 8 with the neural stage.
+    template<class T>
+    static void DecodeChannelWorker(BitStreamReader& bs, size_t count, T* out, bool high_res_mode,
+                                    bool tunable, Stats* stats = nullptr) {
+        if (stats) DecodeChannel<true>(bs, count, out, high_res_mode, tunable, stats);
+        else DecodeChannel<false>(bs, count, out, high_res_mode, tunable, nullptr);
+    }
+
+    template<bool Collect, class T>
+    static void DecodeChannel(BitStreamReader& bs, size_t count, T* out, bool high_res_mode,
+                              bool tunable, Stats* stats) {
         int is_silence = bs.ReadBit();
-        if(is_silence) { std::fill(out.begin(), out.end(), 0); return; }
+        if(is_silence) {
+            if constexpr (Collect) stats->CountChannel(true, 0, 0, false);
+            std::fill(out, out + count, 0);
+            return;
+        }
 
         int shift_lsb = bs.Read(5);
-        int order = 8;
+        int order = tunable ? (int)bs.Read(6) : 8;
         int lpc_shift = bs.Read(5);
-        std::vector<int> lpc_coeffs(order);
+        int lpc_coeffs[64]; // The order field is 6 bits wide
         for(int i=0; i<order; i++) lpc_coeffs[i] = bs.ReadS(16);
+        bool use_neural = tunable ? bs.ReadBit() : true;
+        if constexpr (Collect) stats->CountChannel(false, shift_lsb, order, use_neural);
 
         NeuralPredictor neural;
         uint64_t run_avg = 512;
@@ -146,247 +376,1309 @@ class VeloxCodec {
             if(run_avg > 0) { k = 63 - __builtin_clzll(run_avg); if(k<0) k=0; }
             int64_t finalRes = VeloxEntropy::DecodeSample(bs, k);
             
-            int32_t predNeural = neural.Predict();
+            int32_t predNeural = use_neural ? neural.Predict() : 0;
             int64_t resLPC = finalRes + predNeural;
             int64_t sum = 0;
-            for(int j=0; j<order; j++) {
-                if(i > (size_t)j) sum += (int64_t)lpc_coeffs[j] * out[i-1-j];
+            if (i >= (size_t)order) {
+                const T* hist = out + i - 1;
+                for(int j=0; j<order; j++) sum += (int64_t)lpc_coeffs[j] * hist[-j];
+            } else { // Warm-up: taps before the block start are zero
+                for(size_t j=0; j<i; j++) sum += (int64_t)lpc_coeffs[j] * out[i-1-j];
             }
             int64_t val = resLPC + (sum >> lpc_shift);
-            out[i] = val;
+            out[i] = (T)val;
             
-            neural.Update(resLPC, predNeural);
+            if (use_neural) neural.Update(resLPC, predNeural);
             uint64_t m = VeloxEntropy::ZigZag(finalRes);
+            if constexpr (Collect) stats->CountResidual(m, k);
             run_avg = run_avg - (run_avg>>3) + (m>>3);
             if(run_avg < 1) run_avg = 1;
         }
 
-        LSBShifter::Restore(out, shift_lsb);
+        LSBShifter::Restore(out, count, shift_lsb);
 
         if (high_res_mode) {
             for(size_t i=0; i<count; i++) {
                 uint8_t low = bs.Read(8);
-                out[i] = (out[i] << 8) | low;
+                // Shifted as unsigned: a negative left operand is undefined
+                out[i] = (T)(int64_t)(((uint64_t)(int64_t)out[i] << 8) | low);
             }
         }
     }
 
     // --- RAW BLOCK (SAFE 40-BIT) ---
-    static void WriteRawBlock(const std::vector<velox_sample_t>& samples, BitStreamWriter& bs) {
+    template<class T>
+    static void WriteRawBlock(const std::vector<T>& samples, BitStreamWriter& bs) {
         for(auto s : samples) bs.Write(VeloxEntropy::ZigZag(s), 40); 
     }
     
-    static void ReadRawBlock(BitStreamReader& bs, size_t count, std::vector<velox_sample_t>& out) {
-        out.resize(count);
+    template<class T>
+    static void ReadRawBlock(BitStreamReader& bs, size_t count, T* out) {
         for(size_t i=0; i<count; i++) {
-            out[i] = VeloxEntropy::DeZigZag(bs.Read(40));
+            out[i] = (T)VeloxEntropy::DeZigZag(bs.Read(40));
         }
     }
     
+    // --- CHUNK ENCODER ---
+    struct EncodedChunk {
+        std::vector<uint8_t> data;
+        uint32_t samples;
+    };
+
+    // --- ORDER SEARCH (Max level) ---
+    // Closed-form Rice cost: the coder's adaptive k tracks the mean zigzag
+    // value, so n residuals summing to 'sum' take about n*(k+1) + sum/2^k bits
+    // with k = floor(log2(sum/n)).
+    static uint64_t RiceCost(uint64_t sum, size_t n) {
+        if (n == 0) return 0;
+        uint64_t mean = sum / n;
+        int k = mean ? 63 - __builtin_clzll(mean) : 0;
+        return (uint64_t)n * (k + 1) + (sum >> k);
+    }
+
+    // Channel header plus the estimated residual bits of one coding choice
+    struct ChannelEstimate {
+        ChannelCoding coding;
+        uint64_t bits;
+    };
+
+    // Picks the LPC order in [1, MAX_LPC_ORDER] for one channel without
+    // encoding it. One Levinson recursion yields every order's predictor;
+    // orders are scored by RiceCost over their quantized residuals, on a
+    // coarse 1-2-4-...-32 grid first and then by narrowing around the best.
+    // A hint (the order chosen for the enclosing block) replaces the grid
+    // with a hill climb from that order.
+    template<class T>
+    static ChannelEstimate EstimateChannel(const std::vector<T>& input_data, bool high_res_mode, int hint = 0) {
+        // Runs before a chunk's channels are coded, so it shares their scratch
+        EncodeScratch<T>& scratch = Scratch<T>();
+        std::vector<T>& work_data = scratch.work;
+        work_data.assign(input_data.begin(), input_data.end());
+        size_t n = work_data.size();
+        uint64_t fixedBits = high_res_mode ? 8 * n : 0; // Low bytes are stored verbatim
+        if (high_res_mode) for(auto& val : work_data) val >>= 8;
+        if (VeloxOptimizer::IsSilence(work_data)) return {{8, true}, 1 + fixedBits};
+        LSBShifter::Apply(work_data, LSBShifter::Analyze(work_data));
+
+        double autocorr[MAX_LPC_ORDER + 1];
+        LPCTable a = {{0}}; double e[MAX_LPC_ORDER + 1] = {0};
+        int maxOrder = (int)std::min<size_t>(MAX_LPC_ORDER, n / 2);
+        if (maxOrder < 1) return {{8, true}, 1 + fixedBits};
+        AutocorrelateFast(work_data, maxOrder, autocorr, scratch.real);
+        if (!Levinson(autocorr, maxOrder, a, e)) return {{8, true}, 1 + fixedBits};
+
+        auto lpcSums = SumsKernel(work_data);
+        std::vector<int64_t>& sums = scratch.sums;
+        sums.resize(n);
+        std::vector<int>& coeffs = scratch.coeffs;
+        uint64_t score[MAX_LPC_ORDER + 1];
+        std::fill(score, score + MAX_LPC_ORDER + 1, UINT64_MAX);
+        auto cost = [&](int order) {
+            if (score[order] != UINT64_MAX) return score[order];
+            int shift = 0;
+            QuantizeLPC(a, order, coeffs, shift);
+            lpcSums(work_data.data(), n, coeffs.data(), order, sums.data());
+            uint64_t mag = 0;
+            for (size_t i = 0; i < n; i++) mag += VeloxEntropy::ZigZag((int64_t)work_data[i] - (int32_t)(sums[i] >> shift));
+            return score[order] = RiceCost(mag, n) + 1 + 5 + 6 + 5 + 16 * order + 1 + fixedBits;
+        };
+
+        if (hint > 0) {
+            int best = std::min(hint, maxOrder);
+            for (int step : {-1, 1}) {
+                while (best + step >= 1 && best + step <= maxOrder && cost(best + step) < cost(best)) best += step;
+            }
+            return {{best, true}, cost(best)};
+        }
+
+        int best = 1, lo = 1, hi = 1;
+        for (int p = 1, prev = 1; p <= maxOrder; prev = p, p *= 2) {
+            if (cost(p) < cost(best)) { best = p; lo = prev; }
+            if (p == best) hi = std::min(2 * p, maxOrder);
+        }
+        // Narrow (lo, hi) around the best grid point
+        while (hi - lo > 2) {
+            int left = (lo + best) / 2, right = (best + hi + 1) / 2;
+            if (left > lo && cost(left) < cost(best)) { hi = best; best = left; }
+            else if (right < hi && cost(right) < cost(best)) { lo = best; best = right; }
+            else { lo = left; hi = right; }
+            if (lo >= best) lo = best - 1;
+            if (hi <= best) hi = best + 1;
+        }
+        for (int p = std::max(1, best - 1); p <= std::min(maxOrder, best + 1); p++)
+            if (cost(p) < cost(best)) best = p;
+        return {{best, true}, cost(best)};
+    }
+
+    // Max level: stereo mode, per-channel coding and estimated bits of a
+    // chunk. 'orders' keeps the order estimated for every analysed signal
+    // (L, R, M, S for stereo) as hints for sub-chunks.
+    struct ChunkPlan {
+        int stereo;
+        std::vector<ChannelCoding> codings;
+        uint64_t bits;
+        std::vector<int> orders;
+    };
+
+    template<class T>
+    static void Deinterleave(const T* src, size_t f0, size_t f1, size_t C, std::vector<std::vector<T>>& chans) {
+        size_t len = f1 - f0;
+        chans.resize(C);
+        for(size_t ch=0; ch<C; ch++) {
+            chans[ch].resize(len);
+            for(size_t j=0; j<len; j++) chans[ch][j] = src[(f0 + j) * C + ch];
+        }
+    }
+
+    template<class T>
+    static void MidSide(const std::vector<T>& L, const std::vector<T>& R, std::vector<T>& mid, std::vector<T>& side) {
+        mid.resize(L.size()); side.resize(L.size());
+        for(size_t j=0; j<L.size(); j++) { mid[j] = (L[j]+R[j])>>1; side[j] = L[j]-R[j]; }
+    }
+
+    // Fills 'plan', reusing its buffers
+    template<class T>
+    static void PlanChunk(const std::vector<std::vector<T>>& chans, bool high_res_mode, ChunkPlan& plan,
+                          const ChunkPlan* hint = nullptr) {
+        plan.stereo = STEREO_LR;
+        plan.bits = 64; // Chunk framing
+        plan.codings.clear();
+        plan.orders.clear();
+        auto hintFor = [&](size_t i) { return hint ? hint->orders[i] : 0; };
+        if (chans.size() == 2) {
+            // Estimate L, R, M and S once; each stereo mode is a pair of them
+            EncodeScratch<T>& scratch = Scratch<T>();
+            std::vector<T>& mid = scratch.mid;
+            std::vector<T>& side = scratch.side;
+            MidSide(chans[0], chans[1], mid, side);
+            ChannelEstimate est[4] = {EstimateChannel(chans[0], high_res_mode, hintFor(0)),
+                                      EstimateChannel(chans[1], high_res_mode, hintFor(1)),
+                                      EstimateChannel(mid, high_res_mode, hintFor(2)),
+                                      EstimateChannel(side, high_res_mode, hintFor(3))};
+            for (const auto& e : est) plan.orders.push_back(e.coding.order);
+            static const int pick[4][2] = {{0, 1}, {2, 3}, {0, 3}, {1, 3}};
+            uint64_t bestBits = UINT64_MAX;
+            for (int m = 0; m < 4; m++) {
+                uint64_t bits = est[pick[m][0]].bits + est[pick[m][1]].bits;
+                if (bits < bestBits) { bestBits = bits; plan.stereo = m; }
+            }
+            plan.codings.push_back(est[pick[plan.stereo][0]].coding);
+            plan.codings.push_back(est[pick[plan.stereo][1]].coding);
+            plan.bits += 2 + bestBits;
+        } else {
+            for (size_t ch=0; ch<chans.size(); ch++) {
+                ChannelEstimate est = EstimateChannel(chans[ch], high_res_mode, hintFor(ch));
+                plan.codings.push_back(est.coding);
+                plan.orders.push_back(est.coding.order);
+                plan.bits += est.bits;
+            }
+        }
+    }
+
+    // Frames [f0, f1) of an interleaved stream plus 'tail' loose samples
+    // after frame f1, as one chunk. Stereo picks a decorrelation mode (by
+    // absolute sum for L/R vs M/S, from the plan's estimates over all four
+    // at Max); other layouts code each channel on its own. 'exps' holds the
+    // float exponents of the whole stream, or null when there are none.
+    // 'stats' (optional) gets the counters of the version that is kept.
+    // T is the sample type of the input and of the working buffers.
+    template<class T>
+    static EncodedChunk EncodeChunk(const T* src, const uint8_t* exps, size_t f0, size_t f1, size_t C,
+                                    size_t tail, bool high_res_mode, Level level, const ChunkPlan* plan = nullptr,
+                                    Stats* stats = nullptr) {
+        auto t0 = stats ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+        size_t len = f1 - f0;
+        EncodeScratch<T>& scratch = Scratch<T>();
+        std::vector<std::vector<T>>& chans = scratch.chans;
+        Deinterleave(src, f0, f1, C, chans);
+        std::vector<T>& tailSamples = scratch.tail;
+        tailSamples.assign(src + f1 * C, src + f1 * C + tail);
+
+        ChannelCoding base = (level == Level::Fast) ? ChannelCoding{-1, false} : ChannelCoding{8, true};
+        std::vector<ChannelCoding>& codings = scratch.codings;
+        codings.assign(C, base);
+        int stereo = STEREO_LR;
+        if (level == Level::Max) {
+            ChunkPlan own;
+            if (!plan) { PlanChunk(chans, high_res_mode, own); plan = &own; }
+            stereo = plan->stereo;
+            codings = plan->codings;
+            if (stereo != STEREO_LR) {
+                // Swapped in, so the scratch keeps the replaced buffers
+                std::vector<T>& mid = scratch.mid;
+                std::vector<T>& side = scratch.side;
+                MidSide(chans[0], chans[1], mid, side);
+                if (stereo == STEREO_MS) { chans[0].swap(mid); chans[1].swap(side); }
+                else if (stereo == STEREO_LS) { chans[1].swap(side); }
+                else { chans[0].swap(chans[1]); chans[1].swap(side); }
+            }
+        } else if (C == 2) {
+            std::vector<T>& chunkL = chans[0];
+            std::vector<T>& chunkR = chans[1];
+            uint64_t sad_LR = 0, sad_MS = 0;
+            for(size_t j=0; j<len; j++) {
+                int64_t L = chunkL[j]; int64_t R = chunkR[j];
+                sad_LR += std::abs(L) + std::abs(R);
+                sad_MS += std::abs((L+R)>>1) + std::abs(L-R);
+            }
+            if (sad_MS < sad_LR) {
+                stereo = STEREO_MS;
+                for(size_t j=0; j<len; j++) {
+                    T L = chunkL[j]; T R = chunkR[j];
+                    chunkL[j] = (L+R)>>1; chunkR[j] = L-R;
+                }
+            }
+        }
+
+        uint32_t count = (uint32_t)(len * C + tail);
+        auto t1 = stats ? std::chrono::steady_clock::now() : t0;
+        // Chunk header: high-res flag, then the
+        // exponents of every sample in the chunk
+        auto writeHeader = [&](BitStreamWriter& b) {
+            b.Write(high_res_mode, 1);
+            if (exps) EncodeRLE(exps + f0 * C, count, b);
+        };
+        // Buffers come from the BufferPool with room for the raw version
+        // (40 bits a sample) plus the header: a compressed version that
+        // outgrows it is dropped for the raw one anyway, so its channels
+        // stop being coded once it has. Shorter chunks (Max level halves,
+        // the last chunk) still borrow a full chunk's room, so the pool
+        // holds one size and a buffer never has to regrow.
+        size_t rawSize = (size_t)count * 5;
+        size_t room = std::max((size_t)count, (CHUNK_FRAMES + 1) * C);
+        size_t capacity = room * 5 + (exps ? 2 * room : 0) + 16;
+        // Channel counters only count if the compressed version is kept
+        Stats coded;
+        BitStreamWriter bTemp(capacity);
+        writeHeader(bTemp);
+        bTemp.Write(1, 1);
+        if (C == 2) bTemp.Write(stereo, 2);
+        for(size_t ch=0; ch<C && bTemp.Size() < rawSize; ch++)
+            TryCompressChannel(chans[ch], bTemp, high_res_mode, codings[ch], stats ? &coded : nullptr);
+        WriteRawBlock(tailSamples, bTemp);
+        bTemp.Flush();
+
+        bool raw = bTemp.Size() >= rawSize;
+        EncodedChunk out;
+        if (raw) {
+            BitStreamWriter bRaw(capacity);
+            writeHeader(bRaw);
+            bRaw.Write(0, 1);
+            if (C == 2) bRaw.Write(stereo, 2);
+            for(auto& ch : chans) WriteRawBlock(ch, bRaw);
+            WriteRawBlock(tailSamples, bRaw);
+            bRaw.Flush(); out = {bRaw.TakeData(), count};
+        } else {
+            out = {bTemp.TakeData(), count};
+        }
+        if (stats) {
+            if (!raw) stats->Merge(coded);
+            stats->CountChunk(count, out.data.size(), raw, high_res_mode, stereo, C);
+            stats->analysis_seconds += std::chrono::duration<double>(t1 - t0).count();
+            stats->coding_seconds += SecondsSince(t1);
+        }
+        return out;
+    }
+
+    struct PlannedChunk {
+        size_t f0, f1, tail;
+        ChunkPlan plan;
+    };
+
+    // Per-thread buffers of the Max level planner, kept like EncodeScratch.
+    // 'pieces' is never shrunk, so the plans in it keep their buffers.
+    template<class T>
+    struct PlanScratch {
+        std::vector<std::vector<T>> chans;
+        std::vector<PlannedChunk> pieces;
+    };
+    template<class T>
+    static PlanScratch<T>& PlanBuffers() { static thread_local PlanScratch<T> scratch; return scratch; }
+
+    // Max level: keeps a chunk whole or halves it (depth times) when the
+    // halves are estimated smaller. The kept plans are pieces[0, used) in
+    // stream order; 'pieces' needs 2^(depth+1) - 1 entries, and those past
+    // 'used' are left as spares. Returns the estimated bits.
+    template<class T>
+    static uint64_t PlanSplit(const T* src, size_t f0, size_t f1, size_t C, size_t tail,
+                              bool high_res_mode, int depth, std::vector<PlannedChunk>& pieces, size_t& used,
+                              const ChunkPlan* hint = nullptr) {
+        PlanScratch<T>& scratch = PlanBuffers<T>();
+        size_t w = used++;
+        PlannedChunk& whole = pieces[w];
+        whole.f0 = f0; whole.f1 = f1; whole.tail = tail;
+        Deinterleave(src, f0, f1, C, scratch.chans);
+        PlanChunk(scratch.chans, high_res_mode, whole.plan, hint);
+        if (depth > 0 && f1 - f0 >= 2 * MIN_SPLIT_FRAMES) {
+            size_t mid = f0 + (f1 - f0) / 2;
+            uint64_t split = PlanSplit<T>(src, f0, mid, C, 0, high_res_mode, depth - 1, pieces, used, &whole.plan) +
+                             PlanSplit<T>(src, mid, f1, C, tail, high_res_mode, depth - 1, pieces, used, &whole.plan);
+            if (split < whole.plan.bits) {
+                // The halves move up and the whole chunk's plan becomes a spare
+                std::rotate(pieces.begin() + w, pieces.begin() + w + 1, pieces.begin() + used);
+                used--;
+                return split;
+            }
+            used = w + 1;
+        }
+        return whole.plan.bits;
+    }
+
+    // Max level: splits as PlanSplit decides, but keeps the Default coding
+    // whenever it still comes out smaller (estimates ignore the neural stage).
+    // Replaces the contents of 'out'; chunk buffers that are not kept go
+    // back to the BufferPool. T is the input sample type and the working
+    // one: int32_t halves the memory traffic as long as every sample is in
+    // [-2^30, 2^30), so that mid and side channels fit too. Spans outside
+    // that are widened and coded on 64-bit buffers; both give the same bits.
+    template<class T>
+    static void EncodeSpan(const T* src, const uint8_t* exps, size_t frames, size_t C, size_t tail,
+                           bool high_res_mode, Level level, std::vector<EncodedChunk>& out, Stats* stats = nullptr) {
+        if constexpr (!std::is_same<T, velox_sample_t>::value) {
+            // Spans that are not high-res stay within +-65536 anyway
+            size_t n = frames * C + tail;
+            if (high_res_mode && !FitsInt32(src, n)) {
+                std::vector<velox_sample_t>& wide = Scratch<T>().wide;
+                wide.assign(src, src + n);
+                EncodeSpan<velox_sample_t>(wide.data(), exps, frames, C, tail, high_res_mode, level, out, stats);
+                return;
+            }
+        }
+        out.clear();
+        if (level != Level::Max) {
+            out.push_back(EncodeChunk<T>(src, exps, 0, frames, C, tail, high_res_mode, level, nullptr, stats));
+            return;
+        }
+        auto t0 = stats ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+        const int depth = 1;
+        std::vector<PlannedChunk>& pieces = PlanBuffers<T>().pieces;
+        if (pieces.size() < (size_t(2) << depth) - 1) pieces.resize((size_t(2) << depth) - 1);
+        size_t used = 0;
+        PlanSplit<T>(src, 0, frames, C, tail, high_res_mode, depth, pieces, used);
+        out.reserve(size_t(1) << depth); // Reused outputs stay sized for a full split
+        Stats split, whole;
+        if (stats) split.analysis_seconds = SecondsSince(t0);
+        size_t bytes = 0;
+        for (size_t i = 0; i < used; i++) {
+            const PlannedChunk& p = pieces[i];
+            out.push_back(EncodeChunk<T>(src, exps, p.f0, p.f1, C, p.tail, high_res_mode, level, &p.plan,
+                                      stats ? &split : nullptr));
+            bytes += out.back().data.size() + 8;
+        }
+        EncodedChunk fallback = EncodeChunk<T>(src, exps, 0, frames, C, tail, high_res_mode, Level::Default, nullptr,
+                                            stats ? &whole : nullptr);
+        bool useFallback = fallback.data.size() + 8 < bytes;
+        if (useFallback) {
+            for (auto& chunk : out) BufferPool::Return(std::move(chunk.data));
+            out.clear();
+            out.push_back(std::move(fallback));
+        } else {
+            BufferPool::Return(std::move(fallback.data));
+        }
+        if (stats) {
+            // Time goes to both attempts, counters to the one that is kept
+            Stats& kept = useFallback ? whole : split;
+            Stats& dropped = useFallback ? split : whole;
+            kept.analysis_seconds += dropped.analysis_seconds;
+            kept.coding_seconds += dropped.coding_seconds;
+            stats->Merge(kept);
+        }
+    }
+
+    template<class T>
+    static bool NeedsHighRes(const T* samples, size_t count) {
+        for(size_t i=0; i<count; i++) if(std::abs((int64_t)samples[i]) > 65536) return true;
+        return false;
+    }
+
+    // Every sample in [-2^30, 2^30), so mid and side channels fit 32 bits too
+    template<class T>
+    static bool FitsInt32(const T* samples, size_t count) {
+        uint64_t out = 0;
+        for(size_t i=0; i<count; i++) out |= ((uint64_t)(int64_t)samples[i] + (1ull << 30)) >> 31;
+        return out == 0;
+    }
+
     // Helpers RLE
-    static void EncodeRLE(const std::vector<uint8_t>& data, BitStreamWriter& bs) {
-        if(data.empty()) return;
+    static void EncodeRLE(const uint8_t* data, size_t count, BitStreamWriter& bs) {
+        if(count == 0) return;
         uint8_t last = data[0]; int run = 0;
-        for(size_t i=0; i<data.size(); i++) {
+        for(size_t i=0; i<count; i++) {
             if(data[i] == last && run < 255) run++;
             else { bs.Write(run, 8); bs.Write(last, 8); last = data[i]; run = 1; }
         }
         bs.Write(run, 8); bs.Write(last, 8);
     }
-    static std::vector<uint8_t> DecodeRLE(BitStreamReader& bs, size_t count) {
-        std::vector<uint8_t> out; out.reserve(count);
-        while(out.size() < count) {
+    // Fills out[0, count); a run past the end is cut, a short stream leaves zeros
+    static void DecodeRLE(BitStreamReader& bs, size_t count, uint8_t* out) {
+        size_t pos = 0;
+        while(pos < count) {
             int run = bs.Read(8); int val = bs.Read(8);
-            for(int i=0; i<run; i++) out.push_back(val);
+            if (run == 0) break; // Truncated or corrupt stream
+            size_t n = std::min((size_t)run, count - pos);
+            memset(out + pos, val, n);
+            pos += n;
         }
+        memset(out + pos, 0, count - pos);
+    }
+    static std::vector<uint8_t> DecodeRLE(BitStreamReader& bs, size_t count) {
+        std::vector<uint8_t> out(count);
+        DecodeRLE(bs, count, out.data());
         return out;
     }
 
 public:
-    class Encoder {
+    static constexpr size_t CHUNK_FRAMES = 4096; // Frames per chunk
+    static constexpr size_t MIN_SPLIT_FRAMES = 1024; // Max level never splits below this many frames
+
+    static ThreadPool& GetPool() { static ThreadPool pool(std::max(1u, std::thread::hardware_concurrency())); return pool; }
+
+    // --- STREAMING ENCODER ---
+    // Takes interleaved samples in slices of any size and hands the encoded
+    // stream to a sink in order: the stream prefix first, then each framed
+    // chunk as soon as it and all chunks before it are done. Full chunks are
+    // encoded on the shared pool with at most 'depth' of them buffered or in
+    // flight, so memory does not grow with the stream length. Nothing is
+    // known about the stream up front except its float layout; the caller
+    // patches the sample count and seek table into the file header once
+    // Close() returns. T is the sample type pushed, as for EncodeSpan:
+    // int32_t is meant for integer sources of up to 24 bits (and
+    // pseudo-floats demoted to them) but takes any int32_t, velox_sample_t
+    // takes everything.
+    template<class T>
+    class BasicStreamEncoder {
     public:
-        static ThreadPool& GetPool() { static ThreadPool pool(std::thread::hardware_concurrency()); return pool; }
+        // Receives the next bytes of the stream; called on the pushing thread
+        typedef std::function<void(const uint8_t* data, size_t size)> Sink;
 
-        std::vector<uint8_t> ProcessBlock(std::vector<velox_sample_t>& samples, bool is_float, 
-                                          const std::vector<uint8_t>& exps, const uint8_t* raw_bytes) {
-            BitStreamWriter bs;
-            
-            int float_mode = 0; 
-            if (is_float) {
-                int detected = FormatHandler::DetectPseudoFloat(raw_bytes, samples.size());
-                if (detected == 16) {
-                    float_mode = 1;
-                    FormatHandler::DemoteFloatToInt(raw_bytes, samples.size(), 16, samples);
-                } else if (detected == 24) {
-                    float_mode = 2;
-                    FormatHandler::DemoteFloatToInt(raw_bytes, samples.size(), 24, samples);
-                }
-            }
+        // float_mode: 0 for float mantissas with exponents, 1/2 for floats
+        // demoted to 16/24-bit integers (see FormatHandler::DemoteFloatToInt).
+        // depth 0 keeps two chunks per pool thread.
+        BasicStreamEncoder(Sink out, uint16_t numChannels, bool isFloat = false, int floatMode = 0,
+                           Level lvl = Level::Default, size_t depth = 0)
+            : sink(std::move(out)), C(std::max<uint16_t>(numChannels, 1)), is_float(isFloat),
+              float_mode(isFloat ? floatMode : 0), level(lvl),
+              maxInFlight(depth > 0 ? depth : std::max<size_t>(2 * GetPool().Size(), 2)), window(maxInFlight) {
+            buffer.reserve(CHUNK_FRAMES * C + C);
+            if (HasExponents()) expBuffer.reserve(buffer.capacity());
+            for (size_t i = 0; i < maxInFlight; i++) spans.emplace_back(new SpanSlot());
 
+            BitStreamWriter bs;
             bs.Write(is_float, 1);
-            if(is_float) {
-                bs.Write(float_mode, 2);
-                if (float_mode == 0) EncodeRLE(exps, bs);
-            }
+            if (is_float) bs.Write(float_mode, 2);
+            bs.Flush();
+            Emit(bs.GetData().data(), bs.GetData().size());
+        }
+
+        BasicStreamEncoder(const BasicStreamEncoder&) = delete;
+        BasicStreamEncoder& operator=(const BasicStreamEncoder&) = delete;
 
-            bool high_res_mode = false;
-            if (!is_float || float_mode > 0) {
-                for(auto s : samples) if(std::abs(s) > 65536) { high_res_mode = true; break; }
+        // Spans still in flight read their slots, so they are waited for
+        ~BasicStreamEncoder() {
+            for (size_t i = 0; i < spanCount; i++) GetPool().wait(Span(i).done);
+        }
+
+        // 'exps' is required for float streams in mode 0 and ignored otherwise
+        void Push(const T* samples, const uint8_t* exps, size_t count) {
+            size_t full = CHUNK_FRAMES * C;
+            // A full chunk only goes out once a whole frame follows it, so
+            // loose samples at the end of the stream join the last chunk
+            for (size_t i = 0; i < count; ) {
+                size_t n = std::min(count - i, full + C - buffer.size());
+                buffer.insert(buffer.end(), samples + i, samples + i + n);
+                if (HasExponents()) expBuffer.insert(expBuffer.end(), exps + i, exps + i + n);
+                i += n;
+                totalSamples += n;
+                if (buffer.size() == full + C) Submit(full);
             }
-            bs.Write(high_res_mode, 1);
+        }
 
-            size_t total = samples.size();
-            const size_t SUB_BLOCK = 8192; 
-            std::vector<std::future<std::vector<uint8_t>>> futures;
+        // Encodes what is buffered and waits for every chunk to reach the sink
+        void Close() {
+            if (!buffer.empty()) Submit(buffer.size());
+            while (spanCount > 0) EmitFront();
+        }
 
-            if(total % 2 != 0) { 
-                auto task = [samples, high_res_mode]() {
-                    BitStreamWriter bTemp; bTemp.Write(1, 1);
-                    TryCompressChannel(samples, bTemp, high_res_mode);
-                    bTemp.Flush();
-                    if (bTemp.GetData().size() > samples.size()*5) { 
-                        BitStreamWriter bRaw; bRaw.Write(0, 1);
-                        WriteRawBlock(samples, bRaw); bRaw.Flush(); return bRaw.GetData();
-                    }
-                    return bTemp.GetData();
-                };
-                futures.push_back(GetPool().enqueue(task));
-            } else { 
-                for(size_t i=0; i<total; i += SUB_BLOCK) {
-                    size_t end = std::min(i + SUB_BLOCK, total);
-                    if((end - i) % 2 != 0) end--;
-                    size_t len = (end - i) / 2;
-
-                    std::vector<velox_sample_t> chunkL, chunkR;
-                    chunkL.reserve(len); chunkR.reserve(len);
-                    uint64_t sad_LR = 0, sad_MS = 0;
-
-                    for(size_t j=0; j<len; j++) {
-                        velox_sample_t L = samples[i + j*2]; velox_sample_t R = samples[i + j*2 + 1];
-                        chunkL.push_back(L); chunkR.push_back(R);
-                        sad_LR += std::abs(L) + std::abs(R);
-                        sad_MS += std::abs((L+R)>>1) + std::abs(L-R);
-                    }
-                    
-                    bool use_MS = (sad_MS < sad_LR);
-                    if(use_MS) {
-                        for(size_t j=0; j<len; j++) {
-                            velox_sample_t L = chunkL[j]; velox_sample_t R = chunkR[j];
-                            chunkL[j] = (L+R)>>1; chunkR[j] = L-R;
-                        }
-                    }
+        // Push() and Close() for a stream that is entirely in memory, giving
+        // the same bytes. Chunks are encoded in place, without copies or
+        // futures: pool workers claim spans from a reorder window and this
+        // thread emits them in order as soon as the spans before them are
+        // done. At most maxInFlight spans are outstanding, so memory stays
+        // flat and the first bytes reach the sink right away. A worker that
+        // finds the window full returns its pool thread instead of waiting
+        // on the sink, and this thread starts workers again as it frees
+        // slots. It also encodes whenever there is nothing to emit yet.
+        // Spans are encoded straight into the window's slots, which the
+        // encoder keeps, so once they have cycled no buffer is allocated,
+        // however often workers are restarted or EncodeAll() is called.
+        void EncodeAll(const T* samples, const uint8_t* exps, size_t count) {
+            if (!buffer.empty() || spanCount > 0) { Push(samples, exps, count); Close(); return; }
+            // Same spans as Push(): full ones until the last, which keeps
+            // the loose samples
+            size_t full = CHUNK_FRAMES * C;
+            size_t fullSpans = (count >= full + C) ? (count - C) / full : 0;
+            size_t spans = (count > 0) ? fullSpans + 1 : 0;
+            ReserveSeekTable(count);
 
-                    auto task =[chunkL, chunkR, use_MS, high_res_mode]() {
-                        BitStreamWriter bTemp;
-                        bTemp.Write(1, 1); bTemp.Write(use_MS, 1);
-                        TryCompressChannel(chunkL, bTemp, high_res_mode);
-                        TryCompressChannel(chunkR, bTemp, high_res_mode);
-                        bTemp.Flush();
-                        
-                        size_t rawSize = (chunkL.size() + chunkR.size()) * 5; 
-                        if (bTemp.GetData().size() >= rawSize) {
-                            BitStreamWriter bRaw;
-                            bRaw.Write(0, 1); bRaw.Write(use_MS, 1);
-                            WriteRawBlock(chunkL, bRaw); WriteRawBlock(chunkR, bRaw);
-                            bRaw.Flush(); return bRaw.GetData();
-                        }
-                        return bTemp.GetData();
-                    };
-                    futures.push_back(GetPool().enqueue(task));
+            auto encode = [&](size_t i) {
+                SpanOutput& out = window.Slot(i);
+                size_t start = i * full;
+                size_t n = (i < fullSpans ? start + full : count) - start;
+                const T* src = samples + start;
+                bool hr = !HasExponents() && NeedsHighRes(src, n);
+                if (stats) out.stats = Stats();
+                EncodeSpan(src, HasExponents() ? exps + start : nullptr, n / C, C, n % C, hr, level, out.chunks,
+                           stats ? &out.stats : nullptr);
+                window.Put(i);
+            };
+
+            window.Restart(spans);
+            WaitGroup group;
+            const size_t helpers = std::min(GetPool().Size(), spans);
+            std::atomic<size_t> active{0};
+            auto work = [&]() {
+                for (size_t i; window.TryClaim(i); ) encode(i);
+                active--;
+            };
+            // Tops the workers up to 'helpers' while the window has room. A
+            // worker that is just leaving may still count; it is replaced
+            // after the next emitted span.
+            auto startWorkers = [&]() {
+                while (active.load() < helpers && window.CanClaim()) {
+                    active++;
+                    GetPool().run(group, work);
                 }
+            };
+            startWorkers();
+
+            for (size_t emitted = 0; emitted < spans; emitted++) {
+                size_t i;
+                while (!window.TryTake(emitting)) {
+                    if (window.TryClaim(i)) encode(i);
+                    else { window.Take(emitting); break; }
+                }
+                startWorkers();
+                if (stats) stats->Merge(emitting.stats);
+                EmitChunks(emitting.chunks);
             }
+            totalSamples += count;
+            GetPool().wait(group);
+        }
+
+        // Room in the seek table for 'samples' more samples, for callers that
+        // know the length up front (Max level splits a span into at most two
+        // chunks)
+        void ReserveSeekTable(uint64_t samples) {
+            uint64_t chunks = samples / (CHUNK_FRAMES * C) + 1;
+            seekTable.reserve(seekTable.size() + (size_t)chunks * (level == Level::Max ? 2 : 1));
+        }
 
-            for(auto& f : futures) {
-                auto data = f.get();
-                bs.Write((uint32_t)data.size(), 32);
-                for(uint8_t b : data) bs.Write(b, 8);
+        uint64_t GetTotalSamples() const { return totalSamples; }
+        uint64_t GetBytesWritten() const { return bytesWritten; }
+
+        // Counts chunks submitted from now on; GetStats() is null until then
+        void CollectStats() { if (!stats) stats.reset(new Stats()); }
+        const Stats* GetStats() const { return stats.get(); }
+
+        // One entry per chunk emitted so far. byte_offset is relative to the
+        // first byte given to the sink; writers rebase it to a file offset.
+        const std::vector<VeloxSeekPoint>& GetSeekTable() const { return seekTable; }
+
+    private:
+        Sink sink;
+        size_t C;
+        bool is_float;
+        int float_mode;
+        Level level;
+        size_t maxInFlight;
+        std::vector<T> buffer;
+        std::vector<uint8_t> expBuffer;
+        // One pushed span on the pool: its samples, the chunks they encode
+        // to and the group to wait on. Each span carries its own counters
+        // so workers never share them. The maxInFlight slots are reused
+        // round-robin and their buffers swapped with the push buffers, so
+        // once every slot has been used Push() stops allocating.
+        struct SpanSlot {
+            std::vector<T> samples;
+            std::vector<uint8_t> exps;
+            size_t count = 0; // Samples of the span (the buffers hold more)
+            std::vector<EncodedChunk> chunks;
+            bool collect = false;
+            Stats stats;
+            WaitGroup done;
+        };
+        std::vector<std::unique_ptr<SpanSlot>> spans;
+        size_t spanHead = 0; // Oldest span in flight
+        size_t spanCount = 0;
+        // EncodeAll() spans: the chunks and counters of one encoded span.
+        // 'emitting' is the one being emitted; Take() swaps it back into
+        // the window for reuse.
+        struct SpanOutput {
+            std::vector<EncodedChunk> chunks;
+            Stats stats;
+        };
+        ReorderBuffer<SpanOutput> window;
+        SpanOutput emitting;
+        std::unique_ptr<Stats> stats;
+        std::vector<VeloxSeekPoint> seekTable;
+        uint64_t totalSamples = 0;
+        uint64_t sampleOffset = 0; // Samples already emitted
+        uint64_t bytesWritten = 0;
+
+        bool HasExponents() const { return is_float && float_mode == 0; }
+
+        SpanSlot& Span(size_t i) { return *spans[(spanHead + i) % spans.size()]; }
+
+        // Hands the first 'count' buffered samples to the pool as one span.
+        // The slot takes the push buffers whole; samples after the span
+        // move to the front of the buffers the slot gives back.
+        void Submit(size_t count) {
+            if (spanCount == spans.size()) EmitFront();
+            SpanSlot& slot = Span(spanCount++);
+            size_t capacity = buffer.capacity();
+            slot.samples.swap(buffer);
+            buffer.clear();
+            buffer.reserve(capacity);
+            buffer.insert(buffer.end(), slot.samples.begin() + count, slot.samples.end());
+            if (HasExponents()) {
+                slot.exps.swap(expBuffer);
+                expBuffer.clear();
+                expBuffer.reserve(capacity);
+                expBuffer.insert(expBuffer.end(), slot.exps.begin() + count, slot.exps.end());
             }
-            
-            bs.Flush(); return bs.GetData();
+            slot.count = count;
+            slot.collect = stats != nullptr;
+            if (slot.collect) slot.stats = Stats();
+            GetPool().run(slot.done, [this, s = &slot]() {
+                const T* src = s->samples.data();
+                bool hr = !HasExponents() && NeedsHighRes(src, s->count);
+                EncodeSpan(src, HasExponents() ? s->exps.data() : nullptr, s->count / C, C, s->count % C, hr, level,
+                           s->chunks, s->collect ? &s->stats : nullptr);
+            });
+
+            // Keep the sink busy with whatever is already done in order
+            while (spanCount > 0 && Span(0).done.Idle()) EmitFront();
+        }
+
+        // Byte-aligned framing: each chunk is a 32-bit LE size and a 32-bit
+        // LE sample count followed by its bytes
+        void EmitFront() {
+            SpanSlot& slot = Span(0);
+            GetPool().wait(slot.done);
+            if (slot.collect) stats->Merge(slot.stats);
+            EmitChunks(slot.chunks);
+            spanHead = (spanHead + 1) % spans.size();
+            spanCount--;
+        }
+
+        // Chunk buffers go back to the BufferPool once the sink has them
+        void EmitChunks(std::vector<EncodedChunk>& chunks) {
+            for (auto& chunk : chunks) {
+                seekTable.push_back({sampleOffset, bytesWritten});
+                uint32_t frame[2] = {(uint32_t)chunk.data.size(), chunk.samples};
+                Emit((const uint8_t*)frame, 8);
+                Emit(chunk.data.data(), chunk.data.size());
+                sampleOffset += chunk.samples;
+                BufferPool::Return(std::move(chunk.data));
+            }
+            chunks.clear();
+        }
+
+        void Emit(const uint8_t* data, size_t size) {
+            sink(data, size);
+            bytesWritten += size;
         }
     };
+    typedef BasicStreamEncoder<velox_sample_t> StreamEncoder;
+
+    // Float streams whose values are all exact 16/24-bit integers are coded
+    // as those integers. Replaces 'samples' in that case; returns the
+    // StreamEncoder float mode for the stream.
+    static int DemotePseudoFloat(const uint8_t* raw_bytes, std::vector<velox_sample_t>& samples) {
+        int detected = FormatHandler::DetectPseudoFloat(raw_bytes, samples.size());
+        if (detected != 16 && detected != 24) return 0;
+        FormatHandler::DemoteFloatToInt(raw_bytes, samples.size(), detected, samples);
+        return (detected == 16) ? 1 : 2;
+    }
 
-    class StreamingDecoder {
+    // Whole-file encoder: demotes pseudo-float input, then runs the stream
+    // through a StreamEncoder into one buffer.
+    class Encoder {
+        std::vector<VeloxSeekPoint> seekTable;
+        Level level;
+
+    public:
+        explicit Encoder(Level lvl = Level::Default) : level(lvl) {}
+
+        void SetLevel(Level lvl) { level = lvl; }
+        Level GetLevel() const { return level; }
+
+        static ThreadPool& GetPool() { return VeloxCodec::GetPool(); }
+
+        // One entry per chunk from the last ProcessBlock call. byte_offset is
+        // relative to the start of the returned payload; writers rebase it to
+        // a file offset.
+        const std::vector<VeloxSeekPoint>& GetSeekTable() const { return seekTable; }
+
+        std::vector<uint8_t> ProcessBlock(std::vector<velox_sample_t>& samples, bool is_float, 
+                                          const std::vector<uint8_t>& exps, const uint8_t* raw_bytes,
+                                          uint16_t channels) {
+            int float_mode = is_float ? DemotePseudoFloat(raw_bytes, samples) : 0;
+            return Encode(samples.data(), exps.data(), samples.size(), channels, is_float, float_mode);
+        }
+
+        // Integer PCM as 32-bit samples: the same bytes as the 64-bit
+        // overload, with 32-bit working buffers for sources of up to 24 bits
+        std::vector<uint8_t> ProcessBlock(const std::vector<int32_t>& samples, uint16_t channels) {
+            return Encode(samples.data(), nullptr, samples.size(), channels, false, 0);
+        }
+
+    private:
+        template<class T>
+        std::vector<uint8_t> Encode(const T* samples, const uint8_t* exps, size_t count, uint16_t channels,
+                                    bool is_float, int float_mode) {
+            std::vector<uint8_t> out;
+            BasicStreamEncoder<T> stream([&out](const uint8_t* data, size_t size) {
+                out.insert(out.end(), data, data + size);
+            }, channels, is_float, float_mode, level);
+            stream.EncodeAll(samples, exps, count);
+            seekTable = stream.GetSeekTable();
+            return out;
+        }
+    };
+
+    // --- STREAMING DECODER ---
+    // T is the sample type handed out: velox_sample_t fits every stream,
+    // int32_t halves the buffers for integer sources of up to 24 bits.
+    template<class T>
+    class BasicStreamingDecoder {
+        // One framed chunk: either a view into the caller's buffer or an
+        // owned copy (pulled streams, legacy bit-packed framing).
+        struct ChunkRef {
+            const uint8_t* ptr = nullptr;
+            size_t size = 0;
+            std::vector<uint8_t> owned;
+            size_t start = 0; // Index of the chunk's first sample in the stream
+            size_t frames = 0;
+            size_t tail = 0; // Loose samples after the last whole frame
+        };
+
+        // How chunks of this stream are laid out, fixed by the version and
+        // the stream prefix. VELOX_VERSION_FRAMED chunks are byte-aligned,
+        // carry their sample count, start with their own high-res flag (and
+        // float exponents) and store each channel's order and neural flag.
+        // Legacy chunks are bit-packed stereo pairs with stream-wide flags.
+        struct Layout {
+            size_t channels; // Interleave width (always 2 in legacy streams)
+            bool framed; // VELOX_VERSION_FRAMED
+            bool high_res; // Stream-wide high-res flag (legacy)
+            bool chunk_exps; // Chunks carry float exponents
+        };
+
+        // Channel blocks of a chunk before they are interleaved, and
+        // exponents the caller did not ask for. Grown to a full chunk once
+        // and then reused, so steady-state decoding stays off the heap.
+        // The blocks are 64-bit whatever T is (see DecodeChunk).
+        struct DecodeScratch {
+            std::vector<velox_sample_t> c1, c2;
+            std::vector<uint8_t> exps;
+            void Fit(size_t frames) {
+                if (c1.size() < frames) { c1.resize(std::max(frames, CHUNK_FRAMES)); c2.resize(c1.size()); }
+            }
+        };
+
+        // Decode-ahead slot: a fetched chunk, the buffers its pool task
+        // decodes into and the group to wait on. Slots are sized for the
+        // largest chunk when created and reused round-robin.
+        struct AheadSlot {
+            ChunkRef chunk;
+            size_t count = 0; // Samples the chunk produces
+            std::vector<T> samples;
+            std::vector<uint8_t> exps; // Empty unless chunks carry exponents
+            T* target = nullptr; // Caller's buffer the chunk decodes into instead of 'samples'
+            uint8_t* targetExps = nullptr;
+            DecodeScratch scratch;
+            bool collect = false;
+            Stats stats;
+            WaitGroup done;
+        };
+
+        // In-flight decode-ahead slots in stream order, 'count' of them from
+        // 'head'. Tasks only touch their own slot and target, but may read the
+        // caller's buffer, so they are waited for whenever the ring is dropped.
+        struct AheadRing {
+            std::vector<std::unique_ptr<AheadSlot>> slots;
+            size_t head = 0;
+            size_t count = 0;
+            AheadRing() = default;
+            AheadRing(AheadRing&& o) noexcept : slots(std::move(o.slots)), head(o.head), count(o.count) { o.head = o.count = 0; }
+            AheadRing& operator=(AheadRing&& o) {
+                Wait();
+                slots = std::move(o.slots); head = o.head; count = o.count;
+                o.head = o.count = 0;
+                return *this;
+            }
+            ~AheadRing() { Wait(); }
+            void Wait() { for (size_t i = 0; i < count; i++) At(i).done.Wait(); head = count = 0; }
+            AheadSlot& At(size_t i) { return *slots[(head + i) % slots.size()]; }
+            void Pop() { head = (head + 1) % slots.size(); count--; }
+        };
+
+    public:
+        // Pulls up to n stream bytes into p, returning how many it got (0 at end)
+        typedef std::function<size_t(uint8_t*, size_t)> Source;
+
+    private:
+        const uint8_t* stream;
+        size_t stream_size;
+        Source source; // Set when chunks are pulled instead of read in place
+        uint8_t prefixByte = 0; // Stream prefix of a pulled stream
         BitStreamReader bs;
-        std::vector<uint8_t> exponents;
+        std::vector<uint8_t> exponents; // Whole-stream exponents (legacy)
         size_t total_samples;
         size_t decoded_count = 0;
-        size_t exp_idx = 0;
+        size_t scheduled_count = 0; // Samples covered by chunks already fetched
         bool is_float;
-        int float_mode;
-        bool high_res_mode;
-        std::vector<velox_sample_t> blockBuffer;
+        int float_mode = 0;
+        Layout layout;
+        size_t chunkPos = 0; // Next chunk (framed streams)
+        bool ended = false; // Zero-size chunk seen
+        std::vector<T> blockBuffer; // Staging for DecodeNext/NextBlock
+        std::vector<uint8_t> blockExps; // Exponents of blockBuffer (float streams in mode 0)
         size_t blockPtr = 0;
+        ChunkRef next; // Fetched but not yet decoded (serial mode)
+        bool has_next = false;
+        DecodeScratch scratch; // Serial mode
+        size_t ahead = 0; // Decode-ahead depth (0 = serial)
+        AheadRing pending;
+        std::unique_ptr<Stats> stats;
+
+        // Writes frames * C interleaved samples, then 'tail' raw ones, to out.
+        // Exponents carried by the chunk go to 'exps' unless it is null.
+        static void DecodeChunk(BitStreamReader& bChunk, const Layout& layout, size_t frames, size_t tail,
+                                T* out, uint8_t* exps, DecodeScratch& scratch, Stats* stats = nullptr) {
+            auto t0 = stats ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+            size_t C = layout.channels;
+            bool high_res_mode = layout.high_res;
+            if (layout.framed) {
+                high_res_mode = bChunk.ReadBit();
+                if (layout.chunk_exps) {
+                    size_t n = frames * C + tail;
+                    if (!exps && scratch.exps.size() < n) scratch.exps.resize(std::max(n, (CHUNK_FRAMES + 1) * C));
+                    DecodeRLE(bChunk, n, exps ? exps : scratch.exps.data());
+                }
+            }
+            bool tunable = layout.framed;
+            int mode = bChunk.ReadBit();
+            int stereo = (C == 2) ? (int)bChunk.Read(tunable ? 2 : 1) : STEREO_LR;
+            // Mono decodes in place; wider layouts go through the 64-bit
+            // scratch blocks and are interleaved (M/S undone) on the way out,
+            // so T only narrows the output
+            if (C > 1) scratch.Fit(frames);
+            velox_sample_t* c1 = scratch.c1.data();
+            velox_sample_t* c2 = scratch.c2.data();
+            if (C == 1) {
+                if (mode == 1) DecodeChannelWorker(bChunk, frames, out, high_res_mode, tunable, stats);
+                else ReadRawBlock(bChunk, frames, out);
+            } else if (C == 2) {
+                if (mode == 1) { // Compressed
+                    DecodeChannelWorker(bChunk, frames, c1, high_res_mode, tunable, stats);
+                    DecodeChannelWorker(bChunk, frames, c2, high_res_mode, tunable, stats);
+                } else { // Raw
+                    ReadRawBlock(bChunk, frames, c1);
+                    ReadRawBlock(bChunk, frames, c2);
+                }
+                for(size_t j=0; j<frames; j++) {
+                    switch (stereo) {
+                    case STEREO_MS:
+                        out[2*j] = (T)(c1[j] + ((c2[j]+1)>>1));
+                        out[2*j+1] = (T)(c1[j] - (c2[j]>>1));
+                        break;
+                    case STEREO_LS: out[2*j] = (T)c1[j]; out[2*j+1] = (T)(c1[j] - c2[j]); break;
+                    case STEREO_RS: out[2*j] = (T)(c1[j] + c2[j]); out[2*j+1] = (T)c1[j]; break;
+                    default: out[2*j] = (T)c1[j]; out[2*j+1] = (T)c2[j]; break;
+                    }
+                }
+            } else {
+                for(size_t ch=0; ch<C; ch++) {
+                    if (mode == 1) DecodeChannelWorker(bChunk, frames, c1, high_res_mode, tunable, stats);
+                    else ReadRawBlock(bChunk, frames, c1);
+                    for(size_t j=0; j<frames; j++) out[j*C + ch] = (T)c1[j];
+                }
+            }
+            if (tail > 0) ReadRawBlock(bChunk, tail, out + frames * C);
+            if (stats) {
+                stats->CountChunk((uint32_t)(frames * C + tail), bChunk.Size(), mode == 0, high_res_mode, stereo, C);
+                stats->coding_seconds += SecondsSince(t0);
+            }
+        }
+
+        // Locates the next chunk from its size prefix without decoding it
+        bool FetchChunk(ChunkRef& chunk) {
+            if (ended || scheduled_count >= total_samples) return false;
+            uint32_t chunkSize;
+            uint32_t chunkCount = 0;
+            if (source) {
+                // Framing as below, with each chunk copied out of the source
+                uint8_t frame[8] = {};
+                if (Pull(frame, 8) != 8) { ended = true; return false; }
+                memcpy(&chunkSize, frame, 4);
+                memcpy(&chunkCount, frame + 4, 4);
+                if (chunkSize == 0) { ended = true; return false; }
+                ReserveOwned(chunk, chunkSize);
+                chunk.owned.resize(chunkSize);
+                chunkSize = (uint32_t)Pull(chunk.owned.data(), chunkSize);
+                chunk.ptr = chunk.owned.data();
+            } else if (layout.framed) {
+                // Chunks are read in place from the caller's buffer
+                if (chunkPos + 8 > stream_size) return false;
+                memcpy(&chunkSize, stream + chunkPos, 4);
+                memcpy(&chunkCount, stream + chunkPos + 4, 4);
+                chunkPos += 8;
+                if (chunkSize == 0) { ended = true; return false; }
+                chunkSize = (uint32_t)std::min((size_t)chunkSize, stream_size - chunkPos);
+                chunk.ptr = stream + chunkPos;
+                chunkPos += chunkSize;
+            } else {
+                chunkSize = bs.Read(32);
+                if (chunkSize == 0) { ended = true; return false; }
+                ReserveOwned(chunk, chunkSize);
+                chunk.owned.resize(chunkSize);
+                for(uint32_t i=0; i<chunkSize; i++) chunk.owned[i] = (uint8_t)bs.Read(8);
+                chunk.ptr = chunk.owned.data();
+            }
+            chunk.size = chunkSize;
+
+            size_t remaining = total_samples - scheduled_count;
+            if (layout.framed) {
+                if (chunkCount == 0 || chunkCount > MaxChunkSamples()) return false;
+                chunk.frames = chunkCount / layout.channels;
+                chunk.tail = chunkCount % layout.channels;
+            } else {
+                chunk.frames = std::min(CHUNK_FRAMES, remaining / 2);
+                if (chunk.frames == 0 && remaining > 0) chunk.frames = remaining;
+                chunk.tail = 0;
+            }
+            chunk.start = scheduled_count;
+            scheduled_count += ChunkSamples(chunk);
+            return true;
+        }
+
+        // The first owned copy reserves room for the largest regular chunk
+        // (the raw fallback: 40-bit samples plus unpacked RLE exponents)
+        void ReserveOwned(ChunkRef& chunk, size_t size) const {
+            if (chunk.owned.capacity() < size) chunk.owned.reserve(std::max(size, MaxChunkSamples() * 7 + 16));
+        }
+
+        size_t Pull(uint8_t* p, size_t n) {
+            size_t got = 0;
+            while (got < n) {
+                size_t r = source(p + got, n - got);
+                if (r == 0) break;
+                got += r;
+            }
+            return got;
+        }
+
+        size_t ChunkSamples(const ChunkRef& chunk) const { return chunk.frames * layout.channels + chunk.tail; }
+
+        bool HasExponents() const { return is_float && float_mode == 0; }
+
+        // Exponents of a stream that keeps them in one block ahead of the chunks
+        void StreamExponents(size_t start, size_t count, uint8_t* exps) const {
+            size_t avail = (start < exponents.size()) ? std::min(count, exponents.size() - start) : 0;
+            if (avail > 0) memcpy(exps, exponents.data() + start, avail);
+            memset(exps + avail, 0, count - avail);
+        }
+
+        // Makes sure the next chunk in stream order is known. A fetched but
+        // undecoded chunk comes first, then decode-ahead results in order.
+        // 'out' (with room for 'room' samples) is where the caller takes the
+        // next chunk: decode-ahead chunks that land wholly inside it decode
+        // there directly, so the caller must take them before returning.
+        bool PeekChunk(T* out = nullptr, uint8_t* exps = nullptr, size_t room = 0) {
+            size_t used = has_next ? ChunkSamples(next) : 0; // Samples of out claimed by earlier chunks
+            if (out) for (size_t i = 0; i < pending.count; i++) used += pending.At(i).count;
+            while (ahead > 0) {
+                if (pending.count == 0 && pending.slots.size() != ahead) ResizeAhead();
+                if (pending.count >= pending.slots.size()) break;
+                AheadSlot& slot = pending.At(pending.count);
+                if (!FetchChunk(slot.chunk)) break;
+                slot.count = ChunkSamples(slot.chunk);
+                slot.collect = stats != nullptr;
+                if (slot.collect) slot.stats = Stats();
+                // Only chunks whose header count fits in what is left of 'out'
+                bool direct = out && used <= room && slot.count <= room - used;
+                slot.target = direct ? out + used : nullptr;
+                slot.targetExps = (direct && exps) ? exps + used : nullptr;
+                used += slot.count;
+                pending.count++;
+                GetPool().run(slot.done, [s = &slot, lay = layout]() {
+                    BitStreamReader bChunk(s->chunk.ptr, s->chunk.size);
+                    T* into = s->target ? s->target : s->samples.data();
+                    uint8_t* intoExps = nullptr;
+                    if (lay.chunk_exps) intoExps = s->target ? s->targetExps : s->exps.data();
+                    DecodeChunk(bChunk, lay, s->chunk.frames, s->chunk.tail, into, intoExps, s->scratch,
+                                s->collect ? &s->stats : nullptr);
+                });
+            }
+            if (has_next || pending.count > 0) return true;
+            has_next = FetchChunk(next);
+            return has_next;
+        }
+
+        // Rebuilds the (idle) ring with 'ahead' slots, each sized for the
+        // largest chunk so no later chunk allocates
+        void ResizeAhead() {
+            pending.slots.clear();
+            pending.head = 0;
+            for (size_t i = 0; i < ahead; i++) {
+                std::unique_ptr<AheadSlot> slot(new AheadSlot());
+                slot->samples.resize(MaxChunkSamples());
+                if (layout.chunk_exps) slot->exps.resize(MaxChunkSamples());
+                slot->scratch.Fit(CHUNK_FRAMES);
+                if (source || !layout.framed) ReserveOwned(slot->chunk, 1);
+                pending.slots.push_back(std::move(slot));
+            }
+        }
+
+        // Moves decode-ahead slots that target the caller's buffer back into
+        // their own buffers, waiting for their tasks, so nothing writes to
+        // that buffer once DecodeFrames has returned
+        void DetachTargets() {
+            for (size_t i = 0; i < pending.count; i++) {
+                AheadSlot& slot = pending.At(i);
+                if (!slot.target) continue;
+                GetPool().wait(slot.done);
+                std::copy(slot.target, slot.target + slot.count, slot.samples.begin());
+                if (layout.chunk_exps)
+                    memcpy(slot.exps.data(), slot.targetExps ? slot.targetExps : slot.scratch.exps.data(), slot.count);
+                slot.target = nullptr;
+                slot.targetExps = nullptr;
+            }
+        }
+
+        // Samples the next chunk will produce (call after PeekChunk)
+        size_t PeekSamples() { return has_next ? ChunkSamples(next) : pending.At(0).count; }
+
+        // Decodes the peeked chunk straight into out (PeekSamples() slots).
+        // 'exps' may be null; it gets zeros for streams without exponents.
+        void TakeChunk(T* out, uint8_t* exps) {
+            size_t start, n;
+            if (has_next) {
+                start = next.start;
+                n = ChunkSamples(next);
+                BitStreamReader bChunk(next.ptr, next.size);
+                DecodeChunk(bChunk, layout, next.frames, next.tail, out, exps, scratch, stats.get());
+                has_next = false;
+            } else {
+                AheadSlot& slot = pending.At(0);
+                GetPool().wait(slot.done);
+                start = slot.chunk.start;
+                n = slot.count;
+                if (slot.collect) stats->Merge(slot.stats);
+                if (!slot.target) {
+                    std::copy(slot.samples.begin(), slot.samples.begin() + n, out);
+                    if (exps && layout.chunk_exps) memcpy(exps, slot.exps.data(), n);
+                }
+                pending.Pop();
+            }
+            if (exps && !layout.chunk_exps) {
+                if (HasExponents()) StreamExponents(start, n, exps);
+                else memset(exps, 0, n);
+            }
+        }
+
+        // Refills blockBuffer with the next chunk in stream order
+        bool NextChunk() {
+            blockBuffer.clear();
+            blockExps.clear();
+            blockPtr = 0;
+            if (!PeekChunk()) return false;
+            blockBuffer.resize(PeekSamples());
+            if (HasExponents()) blockExps.resize(blockBuffer.size());
+            TakeChunk(blockBuffer.data(), HasExponents() ? blockExps.data() : nullptr);
+            return !blockBuffer.empty();
+        }
 
     public:
-        StreamingDecoder(const uint8_t* data, size_t size, size_t total) 
-            : bs(data, size), total_samples(total) {
+        BasicStreamingDecoder(const uint8_t* data, size_t size, size_t total, uint16_t version = VELOX_VERSION_LEGACY,
+                         uint16_t numChannels = 2) 
+            : stream(data), stream_size(size), bs(data, size), total_samples(total) {
+            ReadPrefix(version >= VELOX_VERSION_FRAMED, numChannels);
+        }
+
+        // Pulls a VELOX_VERSION_FRAMED stream from 'src' (e.g. a pipe) one
+        // chunk at a time; its prefix is a single byte. 'total' may be
+        // VELOX_SAMPLES_UNKNOWN: decoding then ends at the zero-size chunk.
+        // Such a decoder cannot seek.
+        BasicStreamingDecoder(Source src, size_t total, uint16_t numChannels)
+            : stream(nullptr), stream_size(0), source(std::move(src)), bs(nullptr, 0), total_samples(total) {
+            Pull(&prefixByte, 1);
+            bs = BitStreamReader(&prefixByte, 1);
+            ReadPrefix(true, numChannels);
+        }
+
+    private:
+        void ReadPrefix(bool framed, uint16_t numChannels) {
+            layout.framed = framed;
+            layout.channels = framed ? std::max<uint16_t>(numChannels, 1) : 2;
+            layout.high_res = false;
             is_float = bs.Read(1);
-            if (is_float) {
-                float_mode = bs.Read(2);
-                if (float_mode == 0) exponents = DecodeRLE(bs, total);
+            if (is_float) float_mode = bs.Read(2);
+            layout.chunk_exps = framed && HasExponents();
+            if (!framed) {
+                if (HasExponents()) exponents = DecodeRLE(bs, total_samples);
+                layout.high_res = bs.Read(1);
+            }
+            if (framed) {
+                bs.AlignToByte();
+                chunkPos = bs.BytePos();
+            }
+        }
+
+        // Walks the chunk prefixes from 'pos', the chunk starting at sample
+        // 'start', the way FetchChunk reads them but without decoding. True
+        // when a chunk holding 'sample' is reached.
+        bool Reaches(size_t pos, size_t start, uint64_t sample) const {
+            while (start < total_samples) {
+                if (pos + 8 > stream_size) return false;
+                uint32_t size, count;
+                memcpy(&size, stream + pos, 4);
+                memcpy(&count, stream + pos + 4, 4);
+                if (size == 0 || count == 0 || count > MaxChunkSamples()) return false;
+                start += count;
+                if (sample < start) return true;
+                pos += 8 + (size_t)size;
             }
-            high_res_mode = bs.Read(1);
+            return false;
         }
 
-        bool IsFloat() const { return is_float && (float_mode == 0); }
+    public:
+        bool IsFloat() const { return HasExponents(); }
         int GetFloatMode() const { return float_mode; }
 
-        bool DecodeNext(velox_sample_t& out_val, uint8_t& out_exp) {
-            if (decoded_count >= total_samples) return false;
+        // Largest number of samples a single chunk can produce. Buffers of at
+        // least this size let DecodeFrames work without internal staging.
+        size_t MaxChunkSamples() const {
+            return layout.framed ? CHUNK_FRAMES * layout.channels + layout.channels - 1 : CHUNK_FRAMES * 2;
+        }
 
-            if (blockPtr >= blockBuffer.size()) {
-                blockBuffer.clear();
-                uint32_t chunkSize = bs.Read(32);
-                if (chunkSize == 0) return false;
+        // Decode-ahead: keep up to 'chunks' chunks decoding on the shared pool.
+        // Samples are still returned in stream order. 0 or 1 decodes serially.
+        void SetDecodeAhead(size_t chunks) { ahead = (chunks > 1) ? chunks : 0; }
 
-                std::vector<uint8_t> chunkData; chunkData.reserve(chunkSize);
-                for(uint32_t i=0; i<chunkSize; i++) chunkData.push_back((uint8_t)bs.Read(8));
-                BitStreamReader bChunk(chunkData.data(), chunkSize);
+        // Counts chunks decoded from now on; GetStats() is null until then.
+        // Chunks skipped inside a seek are counted as well.
+        void CollectStats() { if (!stats) stats.reset(new Stats()); }
+        const Stats* GetStats() const { return stats.get(); }
 
-                int mode = bChunk.ReadBit();
-                size_t remaining = total_samples - decoded_count;
-                size_t frames = std::min((size_t)4096, remaining / 2);
-                if (frames == 0 && remaining > 0) frames = remaining;
+        // Jumps to the chunk holding 'sample' using the file's seek table and
+        // skips ahead inside it. byte_offset entries are file offsets, so the
+        // file offset of this decoder's buffer is passed in. Returns false
+        // (decoder unchanged) when no seek point leads to 'sample' through
+        // intact chunks.
+        bool SeekToSample(uint64_t sample, const std::vector<VeloxSeekPoint>& table, uint64_t streamFileOffset) {
+            if (!layout.framed || source || sample >= total_samples) return false;
+            auto it = std::upper_bound(table.begin(), table.end(), sample,
+                [](uint64_t s, const VeloxSeekPoint& p) { return s < p.sample_offset; });
+            if (it == table.begin()) return false;
+            const VeloxSeekPoint& point = *(it - 1);
+            if (point.byte_offset < streamFileOffset || point.byte_offset - streamFileOffset >= stream_size ||
+                !Reaches((size_t)(point.byte_offset - streamFileOffset), (size_t)point.sample_offset, sample))
+                return false;
 
-                if (mode == 1) { // Compressed
-                    int use_MS = bChunk.ReadBit();
-                    std::vector<velox_sample_t> c1, c2;
-                    DecodeChannelWorker(bChunk, frames, c1, high_res_mode);
-                    DecodeChannelWorker(bChunk, frames, c2, high_res_mode);
-                    for(size_t j=0; j<frames; j++) {
-                        if(use_MS) {
-                            blockBuffer.push_back(c1[j] + ((c2[j]+1)>>1));
-                            blockBuffer.push_back(c1[j] - (c2[j]>>1));
-                        } else {
-                            blockBuffer.push_back(c1[j]); blockBuffer.push_back(c2[j]);
-                        }
+            pending.Wait();
+            has_next = false;
+            ended = false;
+            blockBuffer.clear();
+            blockExps.clear();
+            blockPtr = 0;
+            chunkPos = (size_t)(point.byte_offset - streamFileOffset);
+            scheduled_count = decoded_count = (size_t)point.sample_offset;
+
+            while (decoded_count < sample) {
+                if (!NextChunk()) return false; // Ruled out by Reaches()
+                size_t skip = std::min(blockBuffer.size(), (size_t)(sample - decoded_count));
+                blockPtr = skip;
+                decoded_count += skip;
+            }
+            return true;
+        }
+
+        size_t GetPosition() const { return decoded_count; }
+
+        // Block API: fills caller-owned buffers with whole chunks, decoding
+        // each one directly into 'out'. Stops before a chunk that would not
+        // fit; a buffer smaller than MaxChunkSamples() still works but goes
+        // through the internal staging block. With decode-ahead, chunks
+        // started during this call decode into 'out' too, but those already
+        // in flight from an earlier call (or not wholly inside 'out') decode
+        // into their slot and cost one extra copy. Chunks aimed at 'out'
+        // that are still pending when the call returns are waited for and
+        // moved into their slot, so 'out' is never written afterwards.
+        // 'exps' may be null; it gets zeros for streams without float
+        // exponents. Returns samples written (0 at end of stream).
+        size_t DecodeFrames(T* out, uint8_t* exps, size_t capacity) {
+            size_t written = 0;
+            while (written < capacity && decoded_count < total_samples) {
+                size_t limit = std::min(capacity - written, total_samples - decoded_count);
+                size_t n;
+                if (blockPtr < blockBuffer.size()) {
+                    // Leftovers from DecodeNext/NextBlock or a chunk larger than the caller's buffer
+                    n = std::min(limit, blockBuffer.size() - blockPtr);
+                    std::copy(blockBuffer.begin() + blockPtr, blockBuffer.begin() + blockPtr + n, out + written);
+                    if (exps) {
+                        if (blockExps.empty()) memset(exps + written, 0, n);
+                        else memcpy(exps + written, blockExps.data() + blockPtr, n);
                     }
-                } else { // Raw
-                    int use_MS = bChunk.ReadBit();
-                    std::vector<velox_sample_t> c1, c2;
-                    ReadRawBlock(bChunk, frames, c1);
-                    ReadRawBlock(bChunk, frames, c2);
-                    for(size_t j=0; j<frames; j++) {
-                        if(use_MS) {
-                            blockBuffer.push_back(c1[j] + ((c2[j]+1)>>1));
-                            blockBuffer.push_back(c1[j] - (c2[j]>>1));
-                        } else {
-                            blockBuffer.push_back(c1[j]); blockBuffer.push_back(c2[j]);
-                        }
+                    blockPtr += n;
+                } else {
+                    if (!PeekChunk(out + written, exps ? exps + written : nullptr, capacity - written)) break;
+                    size_t chunkSamples = PeekSamples();
+                    if (chunkSamples > capacity - written) {
+                        if (written > 0) break;
+                        if (!NextChunk()) break;
+                        continue;
                     }
+                    TakeChunk(out + written, exps ? exps + written : nullptr);
+                    n = std::min(limit, chunkSamples);
+                    if (n == 0) break;
                 }
-                blockPtr = 0;
+                written += n;
+                decoded_count += n;
             }
+            DetachTargets();
+            return written;
+        }
+
+        // Returns the rest of the current chunk (decoding the next one if
+        // needed). Pointers stay valid until the next decode call. 'exps' is
+        // null unless the stream carries float exponents.
+        size_t NextBlock(const T*& samples, const uint8_t*& exps) {
+            if (decoded_count >= total_samples) return 0;
+            if (blockPtr >= blockBuffer.size() && !NextChunk()) return 0;
+
+            size_t count = std::min(blockBuffer.size() - blockPtr, total_samples - decoded_count);
+            samples = blockBuffer.data() + blockPtr;
+            exps = blockExps.empty() ? nullptr : blockExps.data() + blockPtr;
+            blockPtr += count;
+            decoded_count += count;
+            return count;
+        }
+
+        bool DecodeNext(T& out_val, uint8_t& out_exp) {
+            if (decoded_count >= total_samples) return false;
+            if (blockPtr >= blockBuffer.size() && !NextChunk()) return false;
 
+            out_exp = blockExps.empty() ? 0 : blockExps[blockPtr];
             out_val = blockBuffer[blockPtr++];
-            if (is_float && float_mode == 0 && exp_idx < exponents.size()) out_exp = exponents[exp_idx++];
-            else out_exp = 0;
 
             decoded_count++;
             return true;
         }
     };
+    typedef BasicStreamingDecoder<velox_sample_t> StreamingDecoder;
 };
 
 #endif
\ No newline at end of file
@@ -4,45 +4,158 @@
 #include <vector>
 #include <cstdint>
 #include <cstring>
+#include <mutex>
+
+// --- BUFFER POOL ---
+// Recycles the byte buffers of BitStreamWriters. An encoder borrows one sized
+// for its chunk and gives it back once the bytes have reached their sink, so
+// steady-state encoding cycles through a few buffers instead of allocating
+// per chunk. Buffers are written on pool workers and released by whichever
+// thread emits them, so the free list is shared rather than per thread; it
+// is touched twice per chunk.
+class BufferPool
+{
+    static const size_t MAX_FREE = 64;
+
+    static std::mutex &Mutex()
+    {
+        static std::mutex m;
+        return m;
+    }
+    static std::vector<std::vector<uint8_t>> &FreeList()
+    {
+        static std::vector<std::vector<uint8_t>> free;
+        return free;
+    }
+
+public:
+    // An empty buffer with room for at least 'capacity' bytes. The newest
+    // kept buffer that is big enough is preferred, so mixed sizes (split
+    // Max chunks, short last chunks) do not make big buffers regrow.
+    static std::vector<uint8_t> Borrow(size_t capacity)
+    {
+        std::vector<uint8_t> buf;
+        {
+            std::lock_guard<std::mutex> lock(Mutex());
+            auto &free = FreeList();
+            if (!free.empty())
+            {
+                size_t pick = free.size() - 1;
+                for (size_t i = free.size(); i-- > 0;)
+                    if (free[i].capacity() >= capacity)
+                    {
+                        pick = i;
+                        break;
+                    }
+                buf = std::move(free[pick]);
+                free[pick] = std::move(free.back());
+                free.pop_back();
+            }
+        }
+        buf.clear();
+        buf.reserve(capacity);
+        return buf;
+    }
+
+    // Keeps 'buf' for a later Borrow (drops it once MAX_FREE are kept)
+    static void Return(std::vector<uint8_t> &&buf)
+    {
+        if (buf.capacity() == 0)
+            return;
+        std::lock_guard<std::mutex> lock(Mutex());
+        auto &free = FreeList();
+        if (free.capacity() < MAX_FREE)
+            free.reserve(MAX_FREE);
+        if (free.size() < MAX_FREE)
+            free.push_back(std::move(buf));
+    }
+};
 
 // --- BITSTREAM WRITER (64-BIT UPGRADE) ---
+// Bits are packed LSB-first into a 64-bit accumulator which is flushed to the
+// buffer one little-endian word at a time. Byte layout is identical to the
+// original bit-by-bit writer.
 class BitStreamWriter
 {
     std::vector<uint8_t> buffer;
     uint64_t bit_acc = 0;
     int bit_cnt = 0;
+    bool pooled = false;
+
+    inline void FlushWord()
+    {
+        size_t cur = buffer.size();
+        buffer.resize(cur + 8);
+        memcpy(buffer.data() + cur, &bit_acc, 8);
+    }
 
 public:
-    BitStreamWriter() { buffer.reserve(4 * 1024 * 1024); }
+    BitStreamWriter() = default;
+
+    // Borrows a buffer with room for 'capacity' bytes from the BufferPool.
+    // It goes back there on destruction unless TakeData() hands it on.
+    explicit BitStreamWriter(size_t capacity) : buffer(BufferPool::Borrow(capacity)), pooled(true) {}
+
+    ~BitStreamWriter()
+    {
+        if (pooled)
+            BufferPool::Return(std::move(buffer));
+    }
+
+    BitStreamWriter(const BitStreamWriter &) = delete;
+    BitStreamWriter &operator=(const BitStreamWriter &) = delete;
 
     inline void WriteBit(int bit)
     {
-        if (bit)
-            bit_acc |= (1ULL << bit_cnt);
-        bit_cnt++;
-        if (bit_cnt == 8)
-        {
-            buffer.push_back((uint8_t)bit_acc);
-            bit_acc = 0;
-            bit_cnt = 0;
-        }
+        Write(bit ? 1 : 0, 1);
     }
 
+    // Writes the low n bits of val (0 < n <= 64)
     inline void Write(uint64_t val, int n)
     {
-        for (int i = 0; i < n; i++)
-            WriteBit((val >> i) & 1);
+        if (n < 64)
+            val &= (1ULL << n) - 1;
+        bit_acc |= val << bit_cnt;
+        int room = 64 - bit_cnt;
+        if (n < room)
+        {
+            bit_cnt += n;
+            return;
+        }
+        FlushWord();
+        bit_acc = (room < 64) ? (val >> room) : 0;
+        bit_cnt = n - room;
     }
 
     inline void Flush()
     {
-        if (bit_cnt > 0)
-            buffer.push_back((uint8_t)bit_acc);
+        uint8_t tail[8];
+        memcpy(tail, &bit_acc, 8);
+        int bytes = (bit_cnt + 7) >> 3;
+        buffer.insert(buffer.end(), tail, tail + bytes);
+        bit_acc = 0;
+        bit_cnt = 0;
+    }
+
+    // Pads to a byte boundary, then appends whole bytes with one copy
+    inline void WriteBytes(const uint8_t *src, size_t n)
+    {
+        Flush();
+        buffer.insert(buffer.end(), src, src + n);
     }
     const std::vector<uint8_t> &GetData() const { return buffer; }
+
+    // Bytes written so far, not counting bits still in the accumulator
+    size_t Size() const { return buffer.size(); }
+
+    // Moves the bytes out (call Flush() first); the writer is empty after
+    std::vector<uint8_t> TakeData() { return std::move(buffer); }
 };
 
 // --- BITSTREAM READER ---
+// Keeps up to 64 buffered bits. While at least 8 bytes remain, refills are a
+// single unchecked 64-bit load; the tail of the buffer falls back to bytewise
+// refills. Reading past the end yields zero bits, like the original reader.
 class BitStreamReader
 {
     const uint8_t *data;
@@ -51,32 +164,89 @@ class BitStreamReader
     uint64_t bit_acc = 0;
     int bit_cnt = 0;
 
+    inline void Refill()
+    {
+        if (size - pos >= 8)
+        {
+            uint64_t w;
+            memcpy(&w, data + pos, 8);
+            bit_acc |= w << bit_cnt;
+            pos += (63 - bit_cnt) >> 3;
+            bit_cnt |= 56;
+        }
+        else
+        {
+            while (bit_cnt <= 56 && pos < size)
+            {
+                bit_acc |= (uint64_t)data[pos++] << bit_cnt;
+                bit_cnt += 8;
+            }
+        }
+    }
+
 public:
     BitStreamReader(const uint8_t *d, size_t s) : data(d), size(s) {}
 
     inline int ReadBit()
     {
-        if (bit_cnt == 0)
+        return (int)Read(1);
+    }
+
+    // Drops the bits left in the current byte
+    inline void AlignToByte()
+    {
+        int drop = bit_cnt & 7;
+        bit_acc >>= drop;
+        bit_cnt -= drop;
+    }
+
+    // Position of the next unread byte (only meaningful when byte aligned)
+    inline size_t BytePos() const { return pos - (size_t)(bit_cnt >> 3); }
+
+    // Bytes in the buffer being read
+    inline size_t Size() const { return size; }
+
+    // Reads n bits (0 < n <= 64)
+    inline uint64_t Read(int n)
+    {
+        if (n > 56)
         {
-            if (pos >= size)
-                return 0;
-            bit_acc = data[pos++];
-            bit_cnt = 8;
+            uint64_t lo = Read(32);
+            return lo | (Read(n - 32) << 32);
         }
-        int val = bit_acc & 1;
-        bit_acc >>= 1;
-        bit_cnt--;
+        if (bit_cnt < n)
+            Refill();
+        uint64_t val = bit_acc & ((1ULL << n) - 1);
+        bit_acc >>= n;
+        bit_cnt = (bit_cnt > n) ? bit_cnt - n : 0;
         return val;
     }
 
-    // Change uint32_t to uint64_t
-    inline uint64_t Read(int n)
+    // Counts a run of 1 bits and consumes the terminating 0. The run is found
+    // with one ctz over the buffered word instead of a ReadBit loop.
+    inline uint64_t ReadUnary()
     {
-        uint64_t val = 0;
-        for (int i = 0; i < n; i++)
-            if (ReadBit())
-                val |= (1ULL << i);
-        return val;
+        uint64_t q = 0;
+        for (;;)
+        {
+            if (bit_cnt == 0)
+            {
+                Refill();
+                if (bit_cnt == 0)
+                    return q; // Past the end: reads as 0
+            }
+            uint64_t inv = ~bit_acc;
+            int run = inv ? __builtin_ctzll(inv) : 64;
+            if (run < bit_cnt)
+            {
+                bit_acc = (run < 63) ? (bit_acc >> (run + 1)) : 0;
+                bit_cnt -= run + 1;
+                return q + run;
+            }
+            q += bit_cnt;
+            bit_acc = 0;
+            bit_cnt = 0;
+        }
     }
 
     inline int64_t ReadS(int n)
@@ -92,37 +262,41 @@ public:
 class VeloxEntropy
 {
 public:
-    static inline uint64_t ZigZag(int64_t n) { return (uint64_t)((n << 1) ^ (n >> 63)); }
+    static inline uint64_t ZigZag(int64_t n) { return ((uint64_t)n << 1) ^ (uint64_t)(n >> 63); }
     static inline int64_t DeZigZag(uint64_t n) { return (int64_t)((n >> 1) ^ -(int64_t)(n & 1)); }
 
-    static void EncodeSample(BitStreamWriter &bs, int64_t val, int k)
+    // Rice code: q ones, a zero, then k remainder bits. Quotients of 64 or
+    // more escape to 64 ones, a zero and a 40-bit literal.
+    static inline void EncodeSample(BitStreamWriter &bs, int64_t val, int k)
     {
         uint64_t m = ZigZag(val);
         uint64_t q = m >> k;
-        uint64_t r = m & ((1ULL << k) - 1);
 
         if (q < 64)
         {
-            for (uint64_t i = 0; i < q; i++)
-                bs.WriteBit(1);
-            bs.WriteBit(0);
-            if (k > 0)
-                bs.Write(r, k);
+            uint64_t r = m & ((1ULL << k) - 1);
+            int len = (int)q + 1 + k;
+            if (len < 64)
+            {
+                bs.Write(((1ULL << q) - 1) | (r << (q + 1)), len);
+            }
+            else
+            {
+                bs.Write((1ULL << q) - 1, (int)q + 1);
+                if (k > 0)
+                    bs.Write(r, k);
+            }
         }
         else
         {
-            for (uint64_t i = 0; i < 64; i++)
-                bs.WriteBit(1);
-            bs.WriteBit(0);
-            bs.Write(m, 40);
+            bs.Write(~0ULL, 64);
+            bs.Write(m << 1, 41);
         }
     }
 
-    static int64_t DecodeSample(BitStreamReader &bs, int k)
+    static inline int64_t DecodeSample(BitStreamReader &bs, int k)
     {
-        uint64_t q = 0;
-        while (bs.ReadBit())
-            q++;
+        uint64_t q = bs.ReadUnary();
 
         uint64_t m;
         if (q < 64)
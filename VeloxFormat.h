@@ -12,15 +12,25 @@ class FormatHandler
 public:
     // --- STRICT FLOAT ANALYZER ---
     static int DetectPseudoFloat(const uint8_t *raw_bytes, size_t count)
+    {
+        return DetectPseudoFloat(raw_bytes, count, PseudoFloatStride(count));
+    }
+
+    // Every stride-th sample is checked; a stream of 'count' samples uses
+    // this stride
+    static size_t PseudoFloatStride(uint64_t count)
+    {
+        return (count > 100000) ? 4 : 1;
+    }
+
+    // Checks samples 0, stride, 2*stride... of a block, so blocks that start
+    // on a multiple of the stride see the positions of the whole stream
+    static int DetectPseudoFloat(const uint8_t *raw_bytes, size_t count, size_t stride)
     {
         const float *f_ptr = (const float *)raw_bytes;
         bool fit16 = true;
         bool fit24 = true;
 
-        size_t stride = 1;
-        if (count > 100000)
-            stride = 4; 
-
         for (size_t i = 0; i < count; i += stride)
         {
             float f = f_ptr[i];
@@ -57,7 +67,8 @@ public:
         return 0;
     }
 
-    static void DemoteFloatToInt(const uint8_t *raw_bytes, size_t count, int target_bits, std::vector<velox_sample_t> &out)
+    template <class T>
+    static void DemoteFloatToInt(const uint8_t *raw_bytes, size_t count, int target_bits, std::vector<T> &out)
     {
         out.resize(count);
         const float *f_ptr = (const float *)raw_bytes;
@@ -65,24 +76,32 @@ public:
 
         for (size_t i = 0; i < count; i++)
         {
-            out[i] = (velox_sample_t)std::round(f_ptr[i] * scale);
+            out[i] = (T)std::round(f_ptr[i] * scale);
         }
     }
 
-    static void PromoteIntToFloat(const std::vector<velox_sample_t> &in, int src_bits, std::vector<uint8_t> &out_bytes)
+    template <class T>
+    static void PromoteIntToFloat(const std::vector<T> &in, int src_bits, std::vector<uint8_t> &out_bytes)
     {
-        out_bytes.resize(in.size() * 4);
+        PromoteIntToFloat(in.data(), in.size(), src_bits, out_bytes);
+    }
+
+    template <class T>
+    static void PromoteIntToFloat(const T *in, size_t count, int src_bits, std::vector<uint8_t> &out_bytes)
+    {
+        out_bytes.resize(count * 4);
         float *f_ptr = (float *)out_bytes.data();
         float scale = (src_bits == 16) ? (1.0f / 32768.0f) : (1.0f / 8388608.0f);
 
-        for (size_t i = 0; i < in.size(); i++)
+        for (size_t i = 0; i < count; i++)
         {
             f_ptr[i] = (float)in[i] * scale;
         }
     }
 
+    template <class T>
     static void SplitFloat32(const uint8_t *raw_bytes, size_t count,
-                             std::vector<velox_sample_t> &out_mantissa,
+                             std::vector<T> &out_mantissa,
                              std::vector<uint8_t> &out_exponent)
     {
         out_mantissa.resize(count);
@@ -98,22 +117,29 @@ public:
             if (exp != 0)
                 mant |= 0x800000;
             if (sign)
-                out_mantissa[i] = -(int64_t)mant;
+                out_mantissa[i] = -(T)mant;
             else
-                out_mantissa[i] = (int64_t)mant;
+                out_mantissa[i] = (T)mant;
         }
     }
 
-    static void MergeFloat32(const std::vector<velox_sample_t> &in_mantissa,
+    template <class T>
+    static void MergeFloat32(const std::vector<T> &in_mantissa,
                              const std::vector<uint8_t> &in_exponent,
                              std::vector<uint8_t> &out_bytes)
     {
-        size_t count = in_mantissa.size();
+        MergeFloat32(in_mantissa.data(), in_exponent.data(), in_mantissa.size(), out_bytes);
+    }
+
+    template <class T>
+    static void MergeFloat32(const T *in_mantissa, const uint8_t *in_exponent, size_t count,
+                             std::vector<uint8_t> &out_bytes)
+    {
         out_bytes.resize(count * 4);
         uint32_t *f32_ptr = (uint32_t *)out_bytes.data();
         for (size_t i = 0; i < count; i++)
         {
-            velox_sample_t m_val = in_mantissa[i];
+            int64_t m_val = in_mantissa[i];
             uint8_t exp = in_exponent[i];
             uint32_t sign = 0;
             if (m_val < 0)
@@ -127,7 +153,9 @@ public:
         }
     }
 
-    static void BytesToSamples(const uint8_t *bytes, size_t count, int bits, std::vector<velox_sample_t> &out)
+    // T may be int32_t: every supported width fits it
+    template <class T>
+    static void BytesToSamples(const uint8_t *bytes, size_t count, int bits, std::vector<T> &out)
     {
         out.resize(count);
         size_t idx = 0;
@@ -157,23 +185,31 @@ public:
         }
     }
 
-    static void SamplesToBytes(const std::vector<velox_sample_t> &in, int bits, std::vector<uint8_t> &bytes)
+    template <class T>
+    static void SamplesToBytes(const std::vector<T> &in, int bits, std::vector<uint8_t> &bytes)
+    {
+        SamplesToBytes(in.data(), in.size(), bits, bytes);
+    }
+
+    // Appends the first 'count' samples of 'in' to 'bytes'
+    template <class T>
+    static void SamplesToBytes(const T *in, size_t count, int bits, std::vector<uint8_t> &bytes)
     {
         int bytes_per_sample = bits / 8;
         size_t cur = bytes.size();
-        bytes.resize(cur + in.size() * bytes_per_sample);
+        bytes.resize(cur + count * bytes_per_sample);
         uint8_t *ptr = bytes.data() + cur;
-        for (auto s : in)
+        for (size_t i = 0; i < count; i++)
         {
             if (bits == 16)
             {
-                int16_t v = (int16_t)s;
+                int16_t v = (int16_t)in[i];
                 memcpy(ptr, &v, 2);
                 ptr += 2;
             }
             else if (bits == 24)
             {
-                int32_t v = (int32_t)s;
+                int32_t v = (int32_t)in[i];
                 ptr[0] = v & 0xFF;
                 ptr[1] = (v >> 8) & 0xFF;
                 ptr[2] = (v >> 16) & 0xFF;
@@ -181,7 +217,7 @@ public:
             }
             else if (bits == 32)
             {
-                int32_t v = (int32_t)s;
+                int32_t v = (int32_t)in[i];
                 memcpy(ptr, &v, 4);
                 ptr += 4;
             }
@@ -193,13 +229,14 @@ public:
 class LSBShifter
 {
 public:
-    static int Analyze(std::vector<velox_sample_t> &block)
+    template <class T>
+    static int Analyze(const std::vector<T> &block)
     {
         if (block.empty())
             return 0;
         uint64_t mask = 0;
         for (auto x : block)
-            mask |= (uint64_t)std::abs(x);
+            mask |= (uint64_t)std::abs((int64_t)x);
         if (mask == 0)
             return 0;
         int shift = 0;
@@ -210,19 +247,22 @@ public:
         }
         return shift;
     }
-    static void Apply(std::vector<velox_sample_t> &block, int shift)
+    template <class T>
+    static void Apply(std::vector<T> &block, int shift)
     {
         if (shift <= 0)
             return;
         for (auto &x : block)
             x >>= shift;
     }
-    static void Restore(std::vector<velox_sample_t> &block, int shift)
+    template <class T>
+    static void Restore(T *block, size_t count, int shift)
     {
         if (shift <= 0)
             return;
-        for (auto &x : block)
-            x <<= shift;
+        // Shifted as unsigned: a negative left operand is undefined
+        for (size_t i = 0; i < count; i++)
+            block[i] = (T)(int64_t)((uint64_t)(int64_t)block[i] << shift);
     }
 };
 #endif
\ No newline at end of file
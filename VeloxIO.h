@@ -8,6 +8,149 @@
 #include <algorithm>
 #include <cstdint>
 
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// --- MAPPED FILE ---
+// Read-only view of a whole file. Pages are loaded on first touch, so a
+// decoder can start on the first chunks while the rest is still on disk.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string &path) { Open(path); }
+    ~MappedFile() { Close(); }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool Open(const std::string &path)
+    {
+        Close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER len;
+        if (!GetFileSizeEx(file, &len))
+        {
+            Close();
+            return false;
+        }
+        size = (size_t)len.QuadPart;
+        opened = true;
+        if (size == 0)
+            return true;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping)
+            data = (const uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            Close();
+            return false;
+        }
+        size = (size_t)st.st_size;
+        opened = true;
+        if (size == 0)
+            return true;
+        void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+            data = (const uint8_t *)p;
+#endif
+        if (!data)
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (data)
+            UnmapViewOfFile(data);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data)
+            munmap((void *)data, size);
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
+#endif
+        data = nullptr;
+        size = 0;
+        opened = false;
+    }
+
+    bool IsOpen() const { return opened; }
+    const uint8_t *Data() const { return data; }
+    size_t Size() const { return size; }
+
+    // Hint that the view will be read front to back (more read-ahead, and
+    // pages behind the reader can be dropped early)
+    void AdviseSequential()
+    {
+#ifndef _WIN32
+        if (data)
+            madvise((void *)data, size, MADV_SEQUENTIAL);
+#endif
+    }
+
+    // Starts reading [offset, offset + len) in the background
+    void WillNeed(size_t offset, size_t len)
+    {
+        if (!data || offset >= size)
+            return;
+        if (len > size - offset)
+            len = size - offset;
+#ifdef _WIN32
+#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+        WIN32_MEMORY_RANGE_ENTRY range = {(PVOID)(data + offset), len};
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+#else
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t start = offset / page * page;
+        madvise((void *)(data + start), len + (offset - start), MADV_WILLNEED);
+#endif
+    }
+
+private:
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    bool opened = false;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
 // --- ENDIANNESS UTILS ---
 class EndianUtils
 {
@@ -65,106 +208,157 @@ class AudioLoader
 public:
     static bool DetectAndParse(const std::string &path, AudioMetadata &meta)
     {
-        std::ifstream f(path, std::ios::binary);
-        if (!f.is_open())
+        MappedFile file;
+        if (!file.Open(path))
+            return false;
+        return DetectAndParse(file.Data(), file.Size(), meta);
+    }
+
+    // Parses a WAV/AIFF image already in memory, e.g. a MappedFile view
+    static bool DetectAndParse(const uint8_t *data, size_t size, AudioMetadata &meta)
+    {
+        if (size < 12)
             return false;
 
-        char id[5] = {0};
-        f.read(id, 4);
+        if (memcmp(data, "RIFF", 4) == 0)
+            return ParseWAV(data, size, meta);
+        if (memcmp(data, "FORM", 4) == 0)
+            return ParseAIFF(data, size, meta);
 
-        if (strncmp(id, "RIFF", 4) == 0)
-            return ParseWAV(f, meta);
-        if (strncmp(id, "FORM", 4) == 0)
-            return ParseAIFF(f, meta);
+        return false;
+    }
+
+    // Parses a WAV/AIFF stream that cannot seek, such as stdin. Reads up to
+    // the first audio byte, keeping every byte read in 'head', so dataPos
+    // ends up equal to head.size() and the samples are next in 'in'.
+    static bool ParseStream(std::istream &in, AudioMetadata &meta, std::vector<uint8_t> &head)
+    {
+        head.clear();
+        if (!ReadMore(in, head, 12))
+            return false;
+        bool aiff = (memcmp(head.data(), "FORM", 4) == 0);
+        if (!aiff && memcmp(head.data(), "RIFF", 4) != 0)
+            return false;
 
+        // Chunks are read whole until the audio one, then the memory
+        // parser does the rest on what was read
+        while (ReadMore(in, head, 8))
+        {
+            size_t at = head.size() - 8;
+            uint32_t chunkSize = Read32(head.data(), head.size(), at + 4, aiff);
+            if (!aiff && memcmp(head.data() + at, "data", 4) == 0)
+                return DetectAndParse(head.data(), head.size(), meta) && meta.dataPos == head.size();
+            if (aiff && memcmp(head.data() + at, "SSND", 4) == 0)
+            {
+                if (!ReadMore(in, head, 8))
+                    return false;
+                uint32_t offset = Read32(head.data(), head.size(), at + 8, true);
+                return ReadMore(in, head, offset) && DetectAndParse(head.data(), head.size(), meta) &&
+                       meta.dataPos == head.size();
+            }
+            if (!ReadMore(in, head, (uint64_t)chunkSize + (chunkSize % 2)))
+                return false;
+        }
         return false;
     }
 
 private:
-    static uint32_t Read32(std::ifstream &f, bool bigEndian)
+    // Appends the next n bytes of 'in' to buf, a bounded step at a time so a
+    // bogus chunk size fails at end of input rather than in the allocator
+    static bool ReadMore(std::istream &in, std::vector<uint8_t> &buf, uint64_t n)
+    {
+        while (n > 0)
+        {
+            size_t step = (size_t)std::min<uint64_t>(n, 64 * 1024);
+            size_t old = buf.size();
+            buf.resize(old + step);
+            in.read((char *)buf.data() + old, step);
+            if ((size_t)in.gcount() != step)
+                return false;
+            n -= step;
+        }
+        return true;
+    }
+
+    // Fields past the end of the image read as zero
+    static uint32_t Read32(const uint8_t *data, size_t size, size_t pos, bool bigEndian)
     {
-        uint32_t v;
-        f.read((char *)&v, 4);
+        uint32_t v = 0;
+        if (pos + 4 <= size)
+            memcpy(&v, data + pos, 4);
         return bigEndian ? EndianUtils::Swap32(v) : v;
     }
-    static uint16_t Read16(std::ifstream &f, bool bigEndian)
+    static uint16_t Read16(const uint8_t *data, size_t size, size_t pos, bool bigEndian)
     {
-        uint16_t v;
-        f.read((char *)&v, 2);
+        uint16_t v = 0;
+        if (pos + 2 <= size)
+            memcpy(&v, data + pos, 2);
         return bigEndian ? EndianUtils::Swap16(v) : v;
     }
 
     // WAV Parser (Little Endian)
-    static bool ParseWAV(std::ifstream &f, AudioMetadata &meta)
+    static bool ParseWAV(const uint8_t *data, size_t size, AudioMetadata &meta)
     {
         meta.isBigEndian = false;
-        f.seekg(8, std::ios::beg);
-        char wave[5] = {0};
-        f.read(wave, 4);
-        if (strncmp(wave, "WAVE", 4) != 0)
+        if (memcmp(data + 8, "WAVE", 4) != 0)
             return false;
 
-        while (f.good())
+        uint64_t pos = 12;
+        while (pos + 8 <= size)
         {
-            char chunkID[5] = {0};
-            f.read(chunkID, 4);
-            if (f.gcount() < 4)
-                break;
-            uint32_t size = Read32(f, false);
-            uint32_t nextChunk = (uint32_t)f.tellg() + size + (size % 2);
+            const char *chunkID = (const char *)data + pos;
+            uint32_t chunkSize = Read32(data, size, (size_t)pos + 4, false);
+            pos += 8;
+            uint64_t nextChunk = pos + chunkSize + (chunkSize % 2);
 
             if (strncmp(chunkID, "fmt ", 4) == 0)
             {
-                meta.formatCode = Read16(f, false);
-                meta.channels = Read16(f, false);
-                meta.sampleRate = Read32(f, false);
-                Read32(f, false); // ByteRate
-                Read16(f, false); // BlockAlign
-                meta.bitsPerSample = Read16(f, false);
+                meta.formatCode = Read16(data, size, (size_t)pos, false);
+                meta.channels = Read16(data, size, (size_t)pos + 2, false);
+                meta.sampleRate = Read32(data, size, (size_t)pos + 4, false);
+                // ByteRate (4) and BlockAlign (2) are skipped
+                meta.bitsPerSample = Read16(data, size, (size_t)pos + 14, false);
             }
             else if (strncmp(chunkID, "data", 4) == 0)
             {
-                meta.dataPos = (uint32_t)f.tellg();
-                meta.dataSize = size;
+                meta.dataPos = (uint32_t)pos;
+                meta.dataSize = chunkSize;
                 return true; // Found data, ready to go
             }
-            f.seekg(nextChunk, std::ios::beg);
+            pos = nextChunk;
         }
         return false;
     }
 
     // AIFF Parser (Big Endian)
-    static bool ParseAIFF(std::ifstream &f, AudioMetadata &meta)
+    static bool ParseAIFF(const uint8_t *data, size_t size, AudioMetadata &meta)
     {
         meta.isBigEndian = true;
-        f.seekg(8, std::ios::beg);
-        char aiff[5] = {0};
-        f.read(aiff, 4);
-        if (strncmp(aiff, "AIFF", 4) != 0 && strncmp(aiff, "AIFC", 4) != 0)
+        if (memcmp(data + 8, "AIFF", 4) != 0 && memcmp(data + 8, "AIFC", 4) != 0)
             return false;
 
-        while (f.good())
+        uint64_t pos = 12;
+        while (pos + 8 <= size)
         {
-            char chunkID[5] = {0};
-            f.read(chunkID, 4);
-            if (f.gcount() < 4)
-                break;
-            uint32_t size = Read32(f, true); // AIFF chunk sizes are Big Endian
-            uint32_t nextChunk = (uint32_t)f.tellg() + size + (size % 2);
+            const char *chunkID = (const char *)data + pos;
+            uint32_t chunkSize = Read32(data, size, (size_t)pos + 4, true); // AIFF chunk sizes are Big Endian
+            pos += 8;
+            uint64_t nextChunk = pos + chunkSize + (chunkSize % 2);
 
             if (strncmp(chunkID, "COMM", 4) == 0)
             {
-                meta.channels = Read16(f, true);
-                Read32(f, true); // numSampleFrames
-                meta.bitsPerSample = Read16(f, true);
+                meta.channels = Read16(data, size, (size_t)pos, true);
+                // numSampleFrames (4) is skipped
+                meta.bitsPerSample = Read16(data, size, (size_t)pos + 6, true);
 
                 // SampleRate in AIFF is 80-bit float (Extended).
                 // Simplification: Assume common rates (44100, 48000) stored in exponent/mantissa
                 // This is complex. For now, let's skip strict 80-bit parsing and define fixed logic
                 // OR read 2 bytes exp + 2 bytes mantissa high.
                 // Standard hack:
-                unsigned char srate[10];
-                f.read((char *)srate, 10);
+                unsigned char srate[10] = {0};
+                if (pos + 18 <= size)
+                    memcpy(srate, data + pos + 8, 10);
                 // TODO: Implement ieee80_to_double properly.
                 // For now, let's rely on user metadata or assume standard if parsing fails?
                 // Actually, let's implement a simple parser:
@@ -193,14 +387,13 @@ private:
             }
             else if (strncmp(chunkID, "SSND", 4) == 0)
             {
-                uint32_t offset = Read32(f, true);
-                uint32_t blockSize = Read32(f, true);
-                (void)blockSize;
-                meta.dataPos = (uint32_t)f.tellg() + offset;
-                meta.dataSize = size - 8; // Minus offset/blockSize fields
+                uint32_t offset = Read32(data, size, (size_t)pos, true);
+                // blockSize (4) is unused
+                meta.dataPos = (uint32_t)(pos + 8 + offset);
+                meta.dataSize = chunkSize - 8; // Minus offset/blockSize fields
                 return true;
             }
-            f.seekg(nextChunk, std::ios::beg);
+            pos = nextChunk;
         }
         return false;
     }
@@ -85,7 +85,7 @@ public:
     }
 
     // Serialization
-    void WriteToStream(std::ofstream &out)
+    void WriteToStream(std::ostream &out)
     {
         std::vector<uint8_t> block;
 
@@ -145,7 +145,7 @@ public:
     }
 
     // --- DESERIALIZATION ---
-    bool ReadFromStream(std::ifstream &in)
+    bool ReadFromStream(std::istream &in)
     {
         tags.clear();
         hasCoverArt = false;
@@ -161,9 +161,32 @@ public:
         if (in.gcount() != blockSize)
             return false;
 
-        const uint8_t *ptr = buffer.data();
+        return ParseBlock(buffer.data(), blockSize);
+    }
+
+    // Same as ReadFromStream for a block in memory (e.g. a MappedFile view).
+    // 'consumed' gets the block's full size, including its length prefix.
+    bool ReadFromMemory(const uint8_t *data, size_t size, size_t &consumed)
+    {
+        tags.clear();
+        hasCoverArt = false;
+        consumed = 0;
+
+        uint32_t blockSize;
+        if (size < 4)
+            return false;
+        memcpy(&blockSize, data, 4);
+        if (blockSize > size - 4)
+            return false;
+
+        consumed = 4 + (size_t)blockSize;
+        return ParseBlock(data + 4, blockSize);
+    }
+
+private:
+    bool ParseBlock(const uint8_t *ptr, size_t maxLen)
+    {
         size_t offset = 0;
-        size_t maxLen = blockSize;
 
         // 1. Vendor
         std::string vendor = ReadString(ptr, offset, maxLen);
@@ -210,6 +233,7 @@ public:
         return true;
     }
 
+public:
     void PrintInfo()
     {
         std::cout << "[Metadata] Vendor: Velox Codec\n";
@@ -173,6 +173,27 @@ void DecoderWorker(std::string path)
         }
     }
 
+    in.seekg(vh.header_blob_size, std::ios::cur);
+    // Piped encodes may leave the sample count and footer to a trailer at
+    // the end of the file
+    bool trailing = (vh.footer_blob_size == VELOX_BLOB_TRAILING);
+    if (!trailing)
+        in.seekg(vh.footer_blob_size, std::ios::cur);
+    std::vector<uint8_t> compData((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    if (trailing)
+    {
+        VeloxTrailer trailer;
+        if (!ReadVeloxTrailer(compData.data(), compData.size(), trailer))
+        {
+            Log("Invalid trailer");
+            return;
+        }
+        if (vh.total_samples == VELOX_SAMPLES_UNKNOWN)
+            vh.total_samples = trailer.total_samples;
+        compData.resize(VeloxTrailerTableOffset(compData.size(), trailer));
+    }
+
     currentSampleRate = vh.sample_rate;
     currentChannels = vh.channels;
     size_t total_frames = vh.total_samples / vh.channels;
@@ -196,12 +217,7 @@ void DecoderWorker(std::string path)
     }
     PostMessage(hMain, WM_USER_UPDATE_UI, 0, 0);
 
-    in.seekg(vh.header_blob_size, std::ios::cur);
-    in.seekg(vh.footer_blob_size, std::ios::cur);
-    std::vector<uint8_t> compData((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
-    in.close();
-
-    VeloxCodec::StreamingDecoder dec(compData.data(), compData.size(), vh.total_samples);
+    VeloxCodec::StreamingDecoder dec(compData.data(), compData.size(), vh.total_samples, vh.version, vh.channels);
     int floatMode = dec.GetFloatMode();
     bool isFloat = (vh.format_code == 3);
 
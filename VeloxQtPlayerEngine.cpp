@@ -12,7 +12,6 @@
 #include <cmath>
 #include <condition_variable>
 #include <cstring>
-#include <fstream>
 #include <mutex>
 #include <string>
 
@@ -260,10 +259,14 @@ VeloxQtPlayerEngine::VeloxQtPlayerEngine(QObject *parent)
       audioSession(0),
       seekTargetFrame(0),
       totalSamplesValue(0),
+      formatVersionValue(0),
       channelsValue(0),
       bitsPerSampleValue(0),
       formatCodeValue(0),
       isFloatValue(false),
+      compData(nullptr),
+      compDataSize(0),
+      compDataOffset(0),
       bytesPerFrame(0),
       prebufferBytes(0)
 {
@@ -511,26 +514,50 @@ void VeloxQtPlayerEngine::stopAudio()
 
 bool VeloxQtPlayerEngine::loadFile(const QString &path)
 {
+    // Decoding reads straight from the mapping, so playback starts while
+    // the rest of the file is still being paged in
     std::string pathUtf8 = path.toUtf8().constData();
-    std::ifstream in(pathUtf8.c_str(), std::ios::binary | std::ios::ate);
-    if (!in.is_open())
+    compData = nullptr;
+    compDataSize = 0;
+    if (!fileView.Open(pathUtf8))
     {
         emit errorOccurred("Unable to open file: " + path);
         return false;
     }
+    fileView.AdviseSequential();
 
-    size_t fileSize = static_cast<size_t>(in.tellg());
-    in.seekg(0, std::ios::beg);
-
+    size_t fileSize = fileView.Size();
     VeloxHeader vh;
-    in.read(reinterpret_cast<char *>(&vh), sizeof(vh));
-    if (!in || vh.magic != 0x584C4556)
+    if (fileSize >= sizeof(vh))
+        std::memcpy(&vh, fileView.Data(), sizeof(vh));
+    if (fileSize < sizeof(vh) || vh.magic != 0x584C4556)
     {
         emit errorOccurred("Invalid Velox file: " + path);
         return false;
     }
 
+    // Piped encodes may leave the sample count, seek table and footer
+    // to a trailer at the end of the file
+    VeloxTrailer trailer = {};
+    bool trailing = (vh.footer_blob_size == VELOX_BLOB_TRAILING);
+    if (trailing && !ReadVeloxTrailer(fileView.Data(), fileSize, trailer))
+    {
+        emit errorOccurred("Invalid Velox file: " + path);
+        return false;
+    }
+    uint64_t footerBlobSize = trailing ? 0 : vh.footer_blob_size;
+    uint64_t tableOffset = vh.seek_table_offset;
+    uint64_t tableCount = vh.seek_table_count;
+    if (trailing && vh.total_samples == VELOX_SAMPLES_UNKNOWN)
+        vh.total_samples = trailer.total_samples;
+    if (trailing && tableCount == 0)
+    {
+        tableOffset = VeloxTrailerTableOffset(fileSize, trailer);
+        tableCount = trailer.seek_table_count;
+    }
+
     totalSamplesValue = vh.total_samples;
+    formatVersionValue = vh.version;
     channelsValue = vh.channels;
     bitsPerSampleValue = vh.bits_per_sample & 0x7FFF;
     formatCodeValue = vh.format_code;
@@ -548,9 +575,14 @@ bool VeloxQtPlayerEngine::loadFile(const QString &path)
     framesPlayedAtomic = 0;
     seekTargetFrame = 0;
 
+    size_t pos = sizeof(vh);
     VeloxMetadata meta;
     if (vh.version >= 0x0400)
-        meta.ReadFromStream(in);
+    {
+        size_t metaSize = 0;
+        meta.ReadFromMemory(fileView.Data() + pos, fileSize - pos, metaSize);
+        pos += metaSize;
+    }
 
     QString fileName = QFileInfo(path).fileName();
     QString metaTitle = QString::fromStdString(meta.GetTag("TITLE"));
@@ -584,15 +616,24 @@ bool VeloxQtPlayerEngine::loadFile(const QString &path)
 
     filePathValue = path;
 
-    in.seekg(static_cast<std::streamoff>(vh.header_blob_size), std::ios::cur);
-    in.seekg(static_cast<std::streamoff>(vh.footer_blob_size), std::ios::cur);
-
-    compData.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
-    if (compData.empty())
+    compDataOffset = static_cast<uint64_t>(pos) + vh.header_blob_size + footerBlobSize;
+    if (compDataOffset >= fileSize)
     {
         emit errorOccurred("No compressed audio found in: " + path);
         return false;
     }
+
+    compData = fileView.Data() + compDataOffset;
+    compDataSize = fileSize - static_cast<size_t>(compDataOffset);
+
+    // The seek table sits at the end of the file, inside the payload view
+    seekTable.clear();
+    uint64_t tableBytes = tableCount * sizeof(VeloxSeekPoint);
+    if (tableCount > 0 && tableOffset >= compDataOffset && tableOffset - compDataOffset + tableBytes <= compDataSize)
+    {
+        seekTable.resize(static_cast<size_t>(tableCount));
+        std::memcpy(seekTable.data(), compData + (tableOffset - compDataOffset), tableBytes);
+    }
     return true;
 }
 
@@ -611,15 +652,18 @@ void VeloxQtPlayerEngine::decodeLoop(uint64_t session)
 {
     if (session != activeSession.load())
         return;
-    VeloxCodec::StreamingDecoder decoder(compData.data(), compData.size(), totalSamplesValue);
+    const size_t decodeAhead = 2 * std::max(1u, std::thread::hardware_concurrency());
+    VeloxCodec::StreamingDecoder decoder(compData, compDataSize, totalSamplesValue, formatVersionValue, channelsValue);
+    decoder.SetDecodeAhead(decodeAhead);
     int floatMode = decoder.GetFloatMode();
     bool isFloat = isFloatValue;
     int bits = bitsPerSampleValue;
     uint16_t ch = channelsValue;
 
-    const int batchSize = 16384;
-    std::vector<int16_t> pcmBatch;
-    pcmBatch.reserve(batchSize);
+    const size_t batchSize = std::max<size_t>(16384, decoder.MaxChunkSamples());
+    std::vector<velox_sample_t> sampleBatch(batchSize);
+    std::vector<uint8_t> expBatch(batchSize);
+    std::vector<int16_t> pcmBatch(batchSize);
     size_t samplesDecoded = 0;
 
     while (!stopRequested)
@@ -631,18 +675,21 @@ void VeloxQtPlayerEngine::decodeLoop(uint64_t session)
             if (audioDevice)
                 audioDevice->clear();
             size_t targetSample = static_cast<size_t>(seekTargetFrame.load()) * ch;
-            decoder = VeloxCodec::StreamingDecoder(compData.data(), compData.size(), totalSamplesValue);
+            decoder = VeloxCodec::StreamingDecoder(compData, compDataSize, totalSamplesValue, formatVersionValue, channelsValue);
+            decoder.SetDecodeAhead(decodeAhead);
             floatMode = decoder.GetFloatMode();
             samplesDecoded = 0;
-            velox_sample_t dv;
-            uint8_t de;
+            if (decoder.SeekToSample(targetSample, seekTable, compDataOffset))
+                samplesDecoded = decoder.GetPosition();
+            // Files without a seek table fall back to decoding up to the target
             while (samplesDecoded < targetSample && !stopRequested)
             {
                 if (session != activeSession.load())
                     return;
-                if (!decoder.DecodeNext(dv, de))
+                size_t n = decoder.DecodeFrames(sampleBatch.data(), nullptr, std::min(batchSize, targetSample - samplesDecoded));
+                if (n == 0)
                     break;
-                samplesDecoded++;
+                samplesDecoded += n;
             }
             currentFrameAtomic = static_cast<qint64>(samplesDecoded / ch);
             seekRequested = false;
@@ -654,32 +701,23 @@ void VeloxQtPlayerEngine::decodeLoop(uint64_t session)
             continue;
         }
 
-        pcmBatch.clear();
-        for (int i = 0; i < batchSize; ++i)
+        if (stopRequested || session != activeSession.load())
+            return;
+        size_t n = decoder.DecodeFrames(sampleBatch.data(), expBatch.data(), batchSize);
+        for (size_t i = 0; i < n; ++i)
+            pcmBatch[i] = convertSample(sampleBatch[i], expBatch[i], isFloat, floatMode, bits);
+        samplesDecoded += n;
+
+        if (n > 0 && !audioDevice->push(reinterpret_cast<const uint8_t *>(pcmBatch.data()), n * sizeof(int16_t)))
+            return;
+        if (n == 0 || samplesDecoded >= totalSamplesValue)
         {
-            if (stopRequested || session != activeSession.load())
+            if (session != activeSession.load())
                 return;
-            velox_sample_t val;
-            uint8_t exp;
-            if (!decoder.DecodeNext(val, exp))
-            {
-                if (!pcmBatch.empty())
-                {
-                    if (!audioDevice->push(reinterpret_cast<const uint8_t *>(pcmBatch.data()), pcmBatch.size() * sizeof(int16_t)))
-                        return;
-                }
-                if (session != activeSession.load())
-                    return;
-                audioDevice->setFinished();
-                currentFrameAtomic = static_cast<qint64>(samplesDecoded / ch);
-                return;
-            }
-            pcmBatch.push_back(convertSample(val, exp, isFloat, floatMode, bits));
-            samplesDecoded++;
-        }
-
-        if (!audioDevice->push(reinterpret_cast<const uint8_t *>(pcmBatch.data()), pcmBatch.size() * sizeof(int16_t)))
+            audioDevice->setFinished();
+            currentFrameAtomic = static_cast<qint64>(samplesDecoded / ch);
             return;
+        }
         currentFrameAtomic = static_cast<qint64>(samplesDecoded / ch);
     }
 }
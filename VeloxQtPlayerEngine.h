@@ -12,6 +12,7 @@
 #include <vector>
 
 #include "VeloxCore.h"
+#include "VeloxIO.h"
 #include "VeloxMetadata.h"
 #include "VeloxArch.h"
 
@@ -88,6 +89,7 @@ private:
 
     std::atomic<qint64> seekTargetFrame;
     uint64_t totalSamplesValue;
+    uint16_t formatVersionValue;
     uint16_t channelsValue;
     uint16_t bitsPerSampleValue;
     uint16_t formatCodeValue;
@@ -100,7 +102,11 @@ private:
     QString filePathValue;
     QImage coverArtValue;
 
-    std::vector<uint8_t> compData;
+    MappedFile fileView;
+    const uint8_t *compData; // Compressed payload inside fileView
+    size_t compDataSize;
+    uint64_t compDataOffset;
+    std::vector<VeloxSeekPoint> seekTable;
     size_t bytesPerFrame;
     size_t prebufferBytes;
 };
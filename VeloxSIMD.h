@@ -0,0 +1,190 @@
+#ifndef VELOX_SIMD_H
+#define VELOX_SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "VeloxAdvanced.h"
+
+// x86 kernels are compiled with per-function target attributes, so no global
+// -mavx2 flag is needed and the best one is picked at runtime via cpuid.
+// Define VELOX_NO_SIMD to build the portable scalar code only.
+#if !defined(VELOX_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define VELOX_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define VELOX_SIMD_X86 0
+#endif
+
+// --- LPC KERNELS ---
+// Block LPC prediction sums for the encoder, vectorized across samples. The
+// vector paths multiply with signed 32x32->64 lanes, so samples must fit in 32
+// bits; callers check that and fall back to Scalar(). The sums32 entries read
+// 32-bit sample buffers (the encoder's narrow pipeline), halving the loads.
+// Sums wrap exactly like the scalar code. (Decoder reconstruction is serial:
+// each sample feeds the next prediction, and a vector dot product over
+// just-stored samples stalls on store forwarding, so it stays a scalar loop in
+// VeloxCore.h.)
+class LPCKernels
+{
+public:
+    // sums[i] = sum_j coeffs[j] * x[i-1-j] for i in [0, n); taps before x[0] count as zero
+    typedef void (*SumsFn)(const velox_sample_t *x, size_t n, const int *coeffs, int order, int64_t *sums);
+    typedef void (*Sums32Fn)(const int32_t *x, size_t n, const int *coeffs, int order, int64_t *sums);
+
+    struct Table
+    {
+        SumsFn sums;
+        Sums32Fn sums32;
+        const char *name;
+    };
+
+    static const Table &Get()
+    {
+        static const Table table = Select();
+        return table;
+    }
+
+    static Table Scalar() { return {SumsScalar<velox_sample_t>, SumsScalar<int32_t>, "scalar"}; }
+#if VELOX_SIMD_X86
+    static Table SSE41() { return {SumsSSE41, Sums32SSE41, "sse4.1"}; }
+    static Table AVX2() { return {SumsAVX2, Sums32AVX2, "avx2"}; }
+#endif
+
+private:
+    static Table Select()
+    {
+#if VELOX_SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return AVX2();
+        if (__builtin_cpu_supports("sse4.1"))
+            return SSE41();
+#endif
+        return Scalar();
+    }
+
+    // Warm-up: the first 'order' outputs reach before the block start
+    template <class T>
+    static size_t WarmUp(const T *x, size_t n, const int *coeffs, int order, int64_t *sums)
+    {
+        size_t end = (n < (size_t)order) ? n : (size_t)order;
+        for (size_t i = 0; i < end; i++)
+        {
+            int64_t sum = 0;
+            for (size_t j = 0; j < i; j++)
+                sum += (int64_t)coeffs[j] * x[i - 1 - j];
+            sums[i] = sum;
+        }
+        return end;
+    }
+
+    template <class T>
+    static void SumsTail(const T *x, size_t i, size_t n, const int *coeffs, int order, int64_t *sums)
+    {
+        for (; i < n; i++)
+        {
+            int64_t sum = 0;
+            for (int j = 0; j < order; j++)
+                sum += (int64_t)coeffs[j] * x[i - 1 - j];
+            sums[i] = sum;
+        }
+    }
+
+    // Tap-outer order keeps the inner loop a plain multiply-add stream
+    template <class T>
+    static void SumsScalar(const T *x, size_t n, const int *coeffs, int order, int64_t *sums)
+    {
+        size_t start = WarmUp(x, n, coeffs, order, sums);
+        for (size_t i = start; i < n; i++)
+            sums[i] = 0;
+        for (int j = 0; j < order; j++)
+        {
+            int64_t c = coeffs[j];
+            const T *src = x - 1 - j;
+            for (size_t i = start; i < n; i++)
+                sums[i] += c * src[i];
+        }
+    }
+
+#if VELOX_SIMD_X86
+    __attribute__((target("sse4.1"))) static void SumsSSE41(const velox_sample_t *x, size_t n, const int *coeffs,
+                                                             int order, int64_t *sums)
+    {
+        size_t i = WarmUp(x, n, coeffs, order, sums);
+        for (; i + 2 <= n; i += 2)
+        {
+            __m128i acc = _mm_setzero_si128();
+            for (int j = 0; j < order; j++)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i *)(x + i - 1 - j));
+                acc = _mm_add_epi64(acc, _mm_mul_epi32(v, _mm_set1_epi64x(coeffs[j])));
+            }
+            _mm_storeu_si128((__m128i *)(sums + i), acc);
+        }
+        SumsTail(x, i, n, coeffs, order, sums);
+    }
+
+    __attribute__((target("avx2"))) static void SumsAVX2(const velox_sample_t *x, size_t n, const int *coeffs,
+                                                          int order, int64_t *sums)
+    {
+        size_t i = WarmUp(x, n, coeffs, order, sums);
+        for (; i + 4 <= n; i += 4)
+        {
+            __m256i acc = _mm256_setzero_si256();
+            for (int j = 0; j < order; j++)
+            {
+                __m256i v = _mm256_loadu_si256((const __m256i *)(x + i - 1 - j));
+                acc = _mm256_add_epi64(acc, _mm256_mul_epi32(v, _mm256_set1_epi64x(coeffs[j])));
+            }
+            _mm256_storeu_si256((__m256i *)(sums + i), acc);
+        }
+        SumsTail(x, i, n, coeffs, order, sums);
+    }
+
+    // 32-bit samples are sign-extended to 64-bit lanes on load
+    __attribute__((target("sse4.1"))) static void Sums32SSE41(const int32_t *x, size_t n, const int *coeffs,
+                                                               int order, int64_t *sums)
+    {
+        size_t i = WarmUp(x, n, coeffs, order, sums);
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128i lo = _mm_setzero_si128();
+            __m128i hi = _mm_setzero_si128();
+            for (int j = 0; j < order; j++)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i *)(x + i - 1 - j));
+                __m128i c = _mm_set1_epi64x(coeffs[j]);
+                lo = _mm_add_epi64(lo, _mm_mul_epi32(_mm_cvtepi32_epi64(v), c));
+                hi = _mm_add_epi64(hi, _mm_mul_epi32(_mm_cvtepi32_epi64(_mm_srli_si128(v, 8)), c));
+            }
+            _mm_storeu_si128((__m128i *)(sums + i), lo);
+            _mm_storeu_si128((__m128i *)(sums + i + 2), hi);
+        }
+        SumsTail(x, i, n, coeffs, order, sums);
+    }
+
+    __attribute__((target("avx2"))) static void Sums32AVX2(const int32_t *x, size_t n, const int *coeffs,
+                                                            int order, int64_t *sums)
+    {
+        size_t i = WarmUp(x, n, coeffs, order, sums);
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256i lo = _mm256_setzero_si256();
+            __m256i hi = _mm256_setzero_si256();
+            for (int j = 0; j < order; j++)
+            {
+                const int32_t *src = x + i - 1 - j;
+                __m256i c = _mm256_set1_epi64x(coeffs[j]);
+                lo = _mm256_add_epi64(lo, _mm256_mul_epi32(_mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)src)), c));
+                hi = _mm256_add_epi64(hi, _mm256_mul_epi32(_mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(src + 4))), c));
+            }
+            _mm256_storeu_si256((__m256i *)(sums + i), lo);
+            _mm256_storeu_si256((__m256i *)(sums + i + 4), hi);
+        }
+        SumsTail(x, i, n, coeffs, order, sums);
+    }
+#endif
+};
+
+#endif
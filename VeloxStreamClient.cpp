@@ -358,11 +358,6 @@ void DecoderWorker(size_t trackSize)
 
     VeloxHeader vh;
     ms.read((char *)&vh, sizeof(vh));
-    currentSampleRate = vh.sample_rate;
-    currentChannels = vh.channels;
-    totalFrames = vh.total_samples / vh.channels;
-
-    outputThread = std::thread(OutputWorker);
 
     if (vh.version >= 0x0400)
     {
@@ -371,20 +366,63 @@ void DecoderWorker(size_t trackSize)
         ms.seekg(mSize);
     }
     ms.seekg(vh.header_blob_size);
-    ms.seekg(vh.footer_blob_size);
 
-    size_t dataStartOffset = ms.pos;
-    size_t compSize = trackSize - dataStartOffset;
+    size_t dataStartOffset;
+    size_t compSize;
+    uint64_t totalSamples = vh.total_samples;
+    if (vh.footer_blob_size == VELOX_BLOB_TRAILING)
+    {
+        // Piped encodes keep the sample count and footer in a trailer, so
+        // the whole file is fetched before playback starts
+        Log("Trailing header, waiting for the end of the file...");
+        uiBufferInfo = "(Loading...)";
+        PostMessage(hMain, WM_UPDATE_UI, 0, 0);
+        currentDecoderBytePos = trackSize;
+        while (downloadedBytes < trackSize && !stopReq)
+            Sleep(20);
+        uiBufferInfo = "";
+        if (stopReq)
+            return;
+
+        VeloxTrailer trailer;
+        if (!ReadVeloxTrailer(ms.ptr, trackSize, trailer) || VeloxTrailerTableOffset(trackSize, trailer) < ms.pos)
+        {
+            Log("Invalid trailer");
+            uiStatus = "Invalid File";
+            PostMessage(hMain, WM_UPDATE_UI, 0, 0);
+            audioBuffer.SetFinished();
+            return;
+        }
+        if (totalSamples == VELOX_SAMPLES_UNKNOWN)
+            totalSamples = trailer.total_samples;
+        dataStartOffset = ms.pos;
+        compSize = VeloxTrailerTableOffset(trackSize, trailer) - dataStartOffset;
+    }
+    else
+    {
+        ms.seekg(vh.footer_blob_size);
+        dataStartOffset = ms.pos;
+        compSize = trackSize - dataStartOffset;
+    }
+
+    currentSampleRate = vh.sample_rate;
+    currentChannels = vh.channels;
+    totalFrames = totalSamples / vh.channels;
 
-    VeloxCodec::StreamingDecoder dec(ms.ptr + ms.pos, compSize, vh.total_samples);
+    outputThread = std::thread(OutputWorker);
+
+    VeloxCodec::StreamingDecoder dec(ms.ptr + ms.pos, compSize, totalSamples, vh.version, vh.channels);
     int floatMode = dec.GetFloatMode();
     bool isFloat = (vh.format_code == 3);
 
     size_t localDecoded = 0;
+    const size_t batchSize = dec.MaxChunkSamples();
+    std::vector<velox_sample_t> sampleBatch(batchSize);
+    std::vector<uint8_t> expBatch(batchSize);
     std::vector<int16_t> pcmBatch;
-    pcmBatch.reserve(4096);
+    pcmBatch.reserve(batchSize);
 
-    while (!stopReq && localDecoded < vh.total_samples)
+    while (!stopReq && localDecoded < totalSamples)
     {
 
         // --- HANDLE SEEK ---
@@ -393,7 +431,7 @@ void DecoderWorker(size_t trackSize)
             audioBuffer.Reset();
             size_t targetSample = seekTargetSample;
 
-            dec = VeloxCodec::StreamingDecoder(ms.ptr + dataStartOffset, compSize, vh.total_samples);
+            dec = VeloxCodec::StreamingDecoder(ms.ptr + dataStartOffset, compSize, totalSamples, vh.version, vh.channels);
             floatMode = dec.GetFloatMode();
             localDecoded = 0;
 
@@ -402,12 +440,10 @@ void DecoderWorker(size_t trackSize)
             PostMessage(hMain, WM_UPDATE_UI, 0, 0);
 
             // Fast-forward
-            velox_sample_t val;
-            uint8_t exp;
             while (localDecoded < targetSample && !stopReq)
             {
                 // Ensure network has loaded the segment for seeking
-                size_t approxPos = dataStartOffset + ((localDecoded * compSize) / vh.total_samples);
+                size_t approxPos = dataStartOffset + ((localDecoded * compSize) / totalSamples);
                 while (downloadedBytes < approxPos + 65536 && downloadedBytes < trackSize && !stopReq)
                 {
                     uiBufferInfo = "(Wait Net...)";
@@ -416,9 +452,10 @@ void DecoderWorker(size_t trackSize)
                 }
                 uiBufferInfo = "";
 
-                if (!dec.DecodeNext(val, exp))
+                size_t n = dec.DecodeFrames(sampleBatch.data(), nullptr, std::min(batchSize, targetSample - localDecoded));
+                if (n == 0)
                     break;
-                localDecoded++;
+                localDecoded += n;
             }
             seekReq = false;
             uiStatus = "Playing";
@@ -426,10 +463,10 @@ void DecoderWorker(size_t trackSize)
         }
 
         // Notify Downloader of Decoder position for automatic Sleep/Wakeup
-        currentDecoderBytePos = dataStartOffset + ((localDecoded * compSize) / vh.total_samples);
+        currentDecoderBytePos = dataStartOffset + ((localDecoded * compSize) / totalSamples);
 
         // Wait for network data (If network is slow)
-        while (downloadedBytes < currentDecoderBytePos + 16384 && downloadedBytes < trackSize && !stopReq)
+        while (downloadedBytes < currentDecoderBytePos + 65536 && downloadedBytes < trackSize && !stopReq)
         {
             uiBufferInfo = "(Buffering...)";
             PostMessage(hMain, WM_UPDATE_UI, 0, 0);
@@ -446,17 +483,12 @@ void DecoderWorker(size_t trackSize)
         }
 
         // Decode Chunk
-        int batch = 0;
-        while (batch < 4096 && localDecoded < vh.total_samples && !stopReq)
-        {
-            velox_sample_t val;
-            uint8_t exp;
-            if (!dec.DecodeNext(val, exp))
-                break;
-            pcmBatch.push_back(ConvertSample(val, exp, isFloat, floatMode, vh.bits_per_sample));
-            localDecoded++;
-            batch++;
-        }
+        size_t n = dec.DecodeFrames(sampleBatch.data(), expBatch.data(), batchSize);
+        if (n == 0)
+            break;
+        for (size_t i = 0; i < n; i++)
+            pcmBatch.push_back(ConvertSample(sampleBatch[i], expBatch[i], isFloat, floatMode, vh.bits_per_sample));
+        localDecoded += n;
 
         if (!audioBuffer.Push(pcmBatch))
             break; // If canceled then break
@@ -1,64 +1,429 @@
 #ifndef VELOX_THREADS_H
 #define VELOX_THREADS_H
 
+#include <cstddef>
+#include <algorithm>
 #include <vector>
 #include <queue>
+#include <deque>
+#include <memory>
+#include <atomic>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <functional>
 #include <future>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <stdexcept>
 
+// Move-only void() callable. Callables up to INLINE_SIZE bytes (typical
+// lambdas capturing a few pointers, or a packaged_task) live inside the
+// task; larger ones go to the heap.
+class PoolTask {
+    static const size_t INLINE_SIZE = 64;
+
+    struct Ops {
+        void (*call)(void*);
+        void (*move)(void* dst, void* src); // Move-constructs dst, destroys src
+        void (*destroy)(void*);
+    };
+
+    template<class F> struct InlineOps {
+        static void Call(void* p) { (*static_cast<F*>(p))(); }
+        static void Move(void* dst, void* src) { new (dst) F(std::move(*static_cast<F*>(src))); static_cast<F*>(src)->~F(); }
+        static void Destroy(void* p) { static_cast<F*>(p)->~F(); }
+        static const Ops ops;
+    };
+    template<class F> struct HeapOps {
+        static F*& Ptr(void* p) { return *static_cast<F**>(p); }
+        static void Call(void* p) { (*Ptr(p))(); }
+        static void Move(void* dst, void* src) { new (dst) F*(Ptr(src)); }
+        static void Destroy(void* p) { delete Ptr(p); }
+        static const Ops ops;
+    };
+
+    alignas(std::max_align_t) unsigned char storage[INLINE_SIZE];
+    const Ops* ops = nullptr;
+
+public:
+    PoolTask() = default;
+
+    template<class F, class D = typename std::decay<F>::type,
+             class = typename std::enable_if<!std::is_same<D, PoolTask>::value>::type>
+    PoolTask(F&& f) {
+        if constexpr (sizeof(D) <= INLINE_SIZE && alignof(D) <= alignof(std::max_align_t) &&
+                      std::is_nothrow_move_constructible<D>::value) {
+            new (storage) D(std::forward<F>(f));
+            ops = &InlineOps<D>::ops;
+        } else {
+            new (storage) D*(new D(std::forward<F>(f)));
+            ops = &HeapOps<D>::ops;
+        }
+    }
+
+    PoolTask(PoolTask&& other) noexcept : ops(other.ops) {
+        if (ops) { ops->move(storage, other.storage); other.ops = nullptr; }
+    }
+    PoolTask& operator=(PoolTask&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            ops = other.ops;
+            if (ops) { ops->move(storage, other.storage); other.ops = nullptr; }
+        }
+        return *this;
+    }
+    PoolTask(const PoolTask&) = delete;
+    PoolTask& operator=(const PoolTask&) = delete;
+    ~PoolTask() { Reset(); }
+
+    explicit operator bool() const { return ops != nullptr; }
+    void operator()() { ops->call(storage); }
+
+private:
+    void Reset() { if (ops) { ops->destroy(storage); ops = nullptr; } }
+};
+
+template<class F> const PoolTask::Ops PoolTask::InlineOps<F>::ops = {Call, Move, Destroy};
+template<class F> const PoolTask::Ops PoolTask::HeapOps<F>::ops = {Call, Move, Destroy};
+
+// Double-ended ring of tasks for the pool's worker queues. It grows by
+// doubling and never shrinks, so a pool in steady use stops allocating
+// (std::deque frees and refills its blocks as it drains).
+class TaskRing {
+public:
+    bool empty() const { return count == 0; }
+
+    void push_back(PoolTask&& task) {
+        if (count == slots.size()) Grow();
+        slots[(head + count) % slots.size()] = std::move(task);
+        count++;
+    }
+    PoolTask pop_back() {
+        count--;
+        return std::move(slots[(head + count) % slots.size()]);
+    }
+    PoolTask pop_front() {
+        PoolTask task = std::move(slots[head]);
+        head = (head + 1) % slots.size();
+        count--;
+        return task;
+    }
+
+private:
+    void Grow() {
+        std::vector<PoolTask> bigger(std::max<size_t>(slots.size() * 2, 16));
+        for(size_t i = 0; i < count; i++) bigger[i] = std::move(slots[(head + i) % slots.size()]);
+        slots.swap(bigger);
+        head = 0;
+    }
+
+    std::vector<PoolTask> slots;
+    size_t head = 0;
+    size_t count = 0;
+};
+
+// Counts outstanding tasks. Add() before handing work out, Done() when each
+// piece finishes; Wait() blocks until the count is back to zero. The count
+// is only touched under the lock, so once a waiter sees zero no Done() call
+// is still using the group and it may be destroyed.
+class WaitGroup {
+public:
+    void Add(size_t n = 1) {
+        std::lock_guard<std::mutex> lock(mutex);
+        count += n;
+    }
+    void Done() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--count == 0) idle.notify_all();
+    }
+    bool Idle() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return count == 0;
+    }
+    void Wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this]{ return count == 0; });
+    }
+
+private:
+    size_t count = 0;
+    std::mutex mutex;
+    std::condition_variable idle;
+};
+
+// Work-stealing pool. Every worker owns a task ring: it takes its own newest task
+// first and, when that is empty, steals the oldest task of another worker.
+// Tasks from other threads are spread over the rings round-robin, so
+// submitters and workers rarely meet on the same lock. Idle workers sleep
+// on one condition variable that is only touched while someone sleeps.
 class ThreadPool {
 public:
-    ThreadPool(size_t threads) : stop(false) {
-        for(size_t i = 0; i < threads; ++i)
-            workers.emplace_back([this] {
-                for(;;) {
-                    std::function<void()> task;
-                    {
-                        std::unique_lock<std::mutex> lock(this->queue_mutex);
-                        this->condition.wait(lock, [this]{ return this->stop || !this->tasks.empty(); });
-                        if(this->stop && this->tasks.empty()) return;
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
-                    }
-                    task();
-                }
-            });
+    // At least one worker, so a hardware_concurrency() of 0 still runs tasks
+    explicit ThreadPool(size_t threads) {
+        size_t n = std::max<size_t>(threads, 1);
+        for(size_t i = 0; i < n; ++i) queues.emplace_back(new WorkerQueue());
+        for(size_t i = 0; i < n; ++i) workers.emplace_back([this, i] { WorkerLoop(i); });
     }
 
     template<class F, class... Args>
-    auto enqueue(F&& f, Args&&... args) -> std::future<typename std::result_of<F(Args...)>::type> {
-        using return_type = typename std::result_of<F(Args...)>::type;
-        auto task = std::make_shared<std::packaged_task<return_type()>>(
-            std::bind(std::forward<F>(f), std::forward<Args>(args)...)
-        );
-        std::future<return_type> res = task->get_future();
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex);
-            if(stop) throw std::runtime_error("enqueue on stopped ThreadPool");
-            tasks.emplace([task](){ (*task)(); });
-        }
-        condition.notify_one();
+    auto enqueue(F&& f, Args&&... args) -> std::future<typename std::invoke_result<F, Args...>::type> {
+        using return_type = typename std::invoke_result<F, Args...>::type;
+        std::packaged_task<return_type()> task(std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+        std::future<return_type> res = task.get_future();
+        Submit(PoolTask(std::move(task)));
         return res;
     }
 
+    // Runs f() on the pool as part of 'group'
+    template<class F>
+    void run(WaitGroup& group, F&& f) {
+        group.Add();
+        Submit(PoolTask([&group, fn = std::forward<F>(f)]() mutable { fn(); group.Done(); }));
+    }
+
+    // Waits for 'group', running queued tasks meanwhile, so it is safe to
+    // call from a pool worker as well
+    void wait(WaitGroup& group) {
+        while (!group.Idle()) {
+            PoolTask task;
+            if (!TryTake(CurrentWorker(), task)) { group.Wait(); return; }
+            task();
+        }
+    }
+
+    // Calls f(i) for every i in [begin, end), 'grain' indices per step, and
+    // returns once all calls are done. The calling thread takes part.
+    template<class F>
+    void parallel_for(size_t begin, size_t end, F&& f, size_t grain = 1) {
+        if (begin >= end) return;
+        grain = std::max<size_t>(grain, 1);
+        size_t steps = (end - begin + grain - 1) / grain;
+        std::atomic<size_t> next{begin};
+        auto body = [&]() {
+            for(size_t i; (i = next.fetch_add(grain)) < end; )
+                for(size_t j = i; j < std::min(i + grain, end); j++) f(j);
+        };
+        WaitGroup group;
+        for(size_t h = 0; h + 1 < std::min(steps, workers.size() + 1); h++) run(group, body);
+        body();
+        wait(group);
+    }
+
+    size_t Size() const { return workers.size(); }
+
     ~ThreadPool() {
         {
-            std::unique_lock<std::mutex> lock(queue_mutex);
+            std::lock_guard<std::mutex> lock(sleep_mutex);
             stop = true;
         }
-        condition.notify_all();
+        wake.notify_all();
         for(std::thread &worker: workers) worker.join();
     }
 
 private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        TaskRing tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
     std::vector<std::thread> workers;
-    std::queue<std::function<void()>> tasks;
-    std::mutex queue_mutex;
-    std::condition_variable condition;
-    bool stop;
+    std::atomic<size_t> pending{0}; // Queued, not yet taken
+    std::atomic<size_t> sleepers{0};
+    std::atomic<size_t> next_queue{0};
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    bool stop = false;
+
+    // Index of the calling thread's queue, or SIZE_MAX off the pool
+    size_t CurrentWorker() const {
+        const Slot& slot = ThisThread();
+        return slot.pool == this ? slot.index : SIZE_MAX;
+    }
+    struct Slot { const ThreadPool* pool; size_t index; };
+    static Slot& ThisThread() { static thread_local Slot slot = {nullptr, 0}; return slot; }
+
+    void Submit(PoolTask task) {
+        size_t self = CurrentWorker();
+        size_t q = (self != SIZE_MAX) ? self : next_queue.fetch_add(1) % queues.size();
+        // pending is raised before the push (so it never drops below zero)
+        // and before sleepers is read; a sleeper raises sleepers before
+        // checking pending, so one side always sees the other
+        pending.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(queues[q]->mutex);
+            queues[q]->tasks.push_back(std::move(task));
+        }
+        if (sleepers.load() > 0) {
+            { std::lock_guard<std::mutex> lock(sleep_mutex); }
+            wake.notify_one();
+        }
+    }
+
+    // Own newest task first, then the oldest task of the others
+    bool TryTake(size_t self, PoolTask& task) {
+        if (pending.load() == 0) return false;
+        size_t n = queues.size();
+        if (self != SIZE_MAX) {
+            WorkerQueue& own = *queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = own.tasks.pop_back();
+                pending.fetch_sub(1);
+                return true;
+            }
+        }
+        size_t first = (self != SIZE_MAX) ? self + 1 : 0;
+        for(size_t k = 0; k < n; k++) {
+            WorkerQueue& victim = *queues[(first + k) % n];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.pop_front();
+                pending.fetch_sub(1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void WorkerLoop(size_t index) {
+        ThisThread() = {this, index};
+        for(;;) {
+            PoolTask task;
+            if (TryTake(index, task)) { task(); continue; }
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            sleepers.fetch_add(1);
+            wake.wait(lock, [this]{ return stop || pending.load() > 0; });
+            sleepers.fetch_sub(1);
+            if (stop && pending.load() == 0) return;
+        }
+    }
+};
+
+// Blocking FIFO between pipeline stages. Push waits while 'capacity' items
+// are queued, which throttles a fast producer to its consumer. Pop waits
+// for an item and returns false once the queue is closed and drained.
+template<class T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity > 0 ? capacity : 1), closed(false) {}
+
+    // Returns false (item dropped) if the queue was closed
+    bool Push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this]{ return closed || items.size() < capacity; });
+        if(closed) return false;
+        items.push(std::move(item));
+        not_empty.notify_one();
+        return true;
+    }
+
+    bool Pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this]{ return closed || !items.empty(); });
+        if(items.empty()) return false;
+        item = std::move(items.front());
+        items.pop();
+        not_full.notify_one();
+        return true;
+    }
+
+    // Wakes both sides; queued items can still be popped
+    void Close() {
+        std::unique_lock<std::mutex> lock(mutex);
+        closed = true;
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+private:
+    std::queue<T> items;
+    size_t capacity;
+    std::mutex mutex;
+    std::condition_variable not_full, not_empty;
+    bool closed;
+};
+
+// Puts results of out-of-order work back in sequence with bounded memory.
+// Workers TryClaim() sequence numbers 0..count-1, fill the number's Slot()
+// in place and Put() it; the consumer Take()s them in order. Claiming fails
+// while 'window' numbers are out and not yet taken, so a slow consumer
+// throttles the workers without parking them: a worker returns, and the
+// consumer hands work out again once CanClaim() says a slot is free. Take()
+// swaps the result out and leaves the consumer's previous value in the slot
+// for the next claimer, so the window's buffers cycle without reallocating,
+// also across Restart()s.
+template<class T>
+class ReorderBuffer {
+public:
+    explicit ReorderBuffer(size_t window, size_t count = 0)
+        : slots(window > 0 ? window : 1), filled(slots.size(), false), count(count) {}
+
+    // Hands out 0..count-1 again; every earlier number must have been taken
+    void Restart(size_t newCount) {
+        std::lock_guard<std::mutex> lock(mutex);
+        count = newCount;
+        claimed = taken = 0;
+        std::fill(filled.begin(), filled.end(), false);
+    }
+
+    // Next unclaimed number; false when the window is full or every number
+    // has been handed out
+    bool TryClaim(size_t& seq) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (claimed >= count || claimed >= taken + slots.size()) return false;
+        seq = claimed++;
+        return true;
+    }
+
+    // True when TryClaim() would hand out a number
+    bool CanClaim() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return claimed < count && claimed < taken + slots.size();
+    }
+
+    // Where the result for a claimed number goes; only its claimer touches
+    // it until Put()
+    T& Slot(size_t seq) { return slots[seq % slots.size()]; }
+
+    void Put(size_t seq) {
+        std::lock_guard<std::mutex> lock(mutex);
+        filled[seq % slots.size()] = true;
+        if (seq == taken) ready.notify_one();
+    }
+
+    // Next result in sequence; false once all 'count' have been taken
+    bool Take(T& value) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (taken >= count) return false;
+        ready.wait(lock, [this]{ return filled[taken % slots.size()]; });
+        return Pop(value);
+    }
+
+    // As Take() but returns false instead of waiting for the next result
+    bool TryTake(T& value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return taken < count && filled[taken % slots.size()] && Pop(value);
+    }
+
+private:
+    std::vector<T> slots;
+    std::vector<bool> filled;
+    size_t count;
+    size_t claimed = 0;
+    size_t taken = 0;
+    std::mutex mutex;
+    std::condition_variable ready;
+
+    bool Pop(T& value) {
+        size_t i = taken % slots.size();
+        std::swap(value, slots[i]);
+        filled[i] = false;
+        taken++;
+        return true;
+    }
 };
 
 #endif
\ No newline at end of file
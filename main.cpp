@@ -3,12 +3,27 @@
 #include <vector>
 #include <cstring>
 #include <iomanip>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <filesystem>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+#include <memory>
 
 #include "VeloxCore.h"
 #include "VeloxMetadata.h"
 #include "VeloxIO.h"
 #include "VeloxTagBridge.h"
 
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
 // WAV Header Generator
 // Generate standard WAV header (44 bytes)
 std::vector<uint8_t> GenerateWavHeader(uint32_t sampleRate, uint16_t channels, uint16_t bits, uint32_t dataSize, bool isFloat)
@@ -43,260 +58,1104 @@ std::string GetFileName(const std::string &path)
     return (last == std::string::npos) ? path : path.substr(last + 1);
 }
 
-int main(int argc, char *argv[])
+// --- ENCODE PIPELINE ---
+// Interleaved samples of one read block, converted on the reader thread
+template <class Sample>
+struct PcmBlock
+{
+    std::vector<Sample> samples;
+    std::vector<uint8_t> exps; // Float exponents (float mode 0 only)
+};
+
+static const size_t READ_BLOCK_BYTES = 1024 * 1024;
+static const size_t READ_AHEAD_BLOCKS = 4;
+// The encoder's sink packs the stream into batches of about this size for
+// the writer thread
+static const size_t WRITE_BATCH_BYTES = 256 * 1024;
+static const size_t WRITE_QUEUE_BATCHES = 8; // Batches queued for the writer, both directions
+
+// Read blocks hold whole frames in multiples of 4 samples, so that
+// DetectPseudoFloat with the whole file's stride samples the same positions
+// block by block as it would over the whole file
+static size_t PcmBlockBytes(const AudioMetadata &meta)
+{
+    size_t align = (size_t)std::max(meta.bitsPerSample / 8, 1) * std::max<uint16_t>(meta.channels, 1) * 4;
+    return std::max<size_t>(READ_BLOCK_BYTES / align, 1) * align;
+}
+
+// AIFF samples are big endian
+static void SwapToHost(const AudioMetadata &meta, uint8_t *data, size_t size)
+{
+    if (!meta.isBigEndian)
+        return;
+    if (meta.bitsPerSample == 16)
+        EndianUtils::SwapBuffer16(data, size);
+    else if (meta.bitsPerSample == 24)
+        EndianUtils::SwapBuffer24(data, size);
+    else if (meta.bitsPerSample == 32)
+        EndianUtils::SwapBuffer32(data, size);
+}
+
+// 'want' bytes of the data chunk from 'offset', in host byte order. Points
+// straight into the mapped file when possible. AIFF data, and data that the
+// file cuts short, go through 'scratch'; missing bytes read as zeros.
+static const uint8_t *PcmBytes(const MappedFile &src, const AudioMetadata &meta, uint64_t offset, size_t want,
+                               std::vector<uint8_t> &scratch)
+{
+    uint64_t pos = (uint64_t)meta.dataPos + offset;
+    size_t avail = (pos < src.Size()) ? (size_t)std::min<uint64_t>(want, src.Size() - pos) : 0;
+    if (avail == want && !meta.isBigEndian)
+        return src.Data() + pos;
+
+    scratch.resize(want);
+    if (avail > 0)
+        memcpy(scratch.data(), src.Data() + pos, avail);
+    memset(scratch.data() + avail, 0, want - avail);
+    SwapToHost(meta, scratch.data(), scratch.size());
+    return scratch.data();
+}
+
+// Up to n bytes of a pipe (fewer at end of input)
+static std::vector<uint8_t> ReadPipe(std::istream &in, uint64_t n)
 {
-    std::cout << "=== VELOX CODEC v1.1 (Universal) ===\n";
-    if (argc < 4)
+    std::vector<uint8_t> buf;
+    char step[64 * 1024];
+    while (n > 0)
     {
-        std::cout << "Usage:\n";
-        std::cout << "  Encode: velox -c input.wav/aif output.vlx [Artist] [Title]\n";
-        std::cout << "  Decode: velox -d input.vlx output.wav\n";
-        return 1;
+        size_t want = (size_t)std::min<uint64_t>(n, sizeof(step));
+        in.read(step, want);
+        size_t got = (size_t)in.gcount();
+        buf.insert(buf.end(), step, step + got);
+        n -= got;
+        if (got < want)
+            break;
     }
+    return buf;
+}
 
-    std::string mode = argv[1];
-    std::string inF = argv[2];
-    std::string outF = argv[3];
+// Streaming writers that cannot patch their header leave the data size at 0
+// or 0xFFFFFFFF; the audio then runs to the end of the input
+static bool PipeOpenEnded(const AudioMetadata &meta)
+{
+    return !meta.isBigEndian && (meta.dataSize == 0 || meta.dataSize == 0xFFFFFFFF);
+}
 
-    // Encode mode
-    if (mode == "-c")
+// Reads the data chunk from a pipe a block at a time, handing each block in
+// host byte order to 'push'. Open-ended data keeps any bytes short of a whole
+// sample as the footer. Sized data is zero-padded like a truncated file, and
+// the WAV input past it and its pad byte becomes the footer. Returns the data
+// bytes pushed.
+template <class Push>
+static uint64_t PipePcm(std::istream &in, const AudioMetadata &meta, Push push, std::vector<uint8_t> &footer)
+{
+    bool openEnded = PipeOpenEnded(meta);
+    uint64_t limit = openEnded ? UINT64_MAX : meta.dataSize;
+    size_t sampleBytes = (size_t)std::max(meta.bitsPerSample / 8, 1);
+    size_t blockBytes = PcmBlockBytes(meta);
+    std::vector<uint8_t> buf;
+    uint64_t total = 0;
+    bool eof = false;
+    while (total < limit && !eof)
     {
-        std::string metaArtist = "Unknown Artist";
-        std::string metaTitle = GetFileName(inF);
-        bool userProvidedTags = false;
-
-        if (argc > 4)
+        size_t want = (size_t)std::min<uint64_t>(blockBytes, limit - total);
+        buf.resize(want);
+        in.read((char *)buf.data(), want);
+        size_t got = (size_t)in.gcount();
+        eof = (got < want);
+        if (eof && openEnded)
         {
-            metaArtist = argv[4];
-            userProvidedTags = true;
+            size_t whole = got - got % sampleBytes;
+            footer.assign(buf.begin() + whole, buf.begin() + got);
+            got = whole;
         }
-        if (argc > 5)
+        else if (eof)
         {
-            metaTitle = argv[5];
-            userProvidedTags = true;
+            memset(buf.data() + got, 0, want - got);
+            got = want;
         }
+        if (got == 0)
+            break;
+        SwapToHost(meta, buf.data(), got);
+        if (!push(buf.data(), got))
+            break;
+        total += got;
+    }
 
-        // 1. Analyze input file (WAV/AIFF)
-        AudioMetadata metaInfo;
-        if (!AudioLoader::DetectAndParse(inF, metaInfo))
-        {
-            std::cerr << "Error: Unsupported format or invalid file.\n";
-            return 1;
-        }
+    if (!openEnded && !eof && !meta.isBigEndian)
+    {
+        if (meta.dataSize % 2 != 0)
+            in.get();
+        footer = ReadPipe(in, UINT64_MAX);
+    }
+    return total;
+}
+
+// Float mode for the whole data chunk: 1/2 if every block holds floats that
+// are exact 16/24-bit integers, else 0. Blocks are checked with the stride
+// the length of the whole chunk calls for, as one scan over it would be.
+static int ScanFloatMode(const MappedFile &src, const AudioMetadata &meta)
+{
+    std::vector<uint8_t> scratch;
+    size_t blockBytes = PcmBlockBytes(meta);
+    size_t stride = FormatHandler::PseudoFloatStride(meta.dataSize / 4);
+    int widest = 16;
+    for (uint64_t off = 0; off < meta.dataSize; off += blockBytes)
+    {
+        size_t want = (size_t)std::min<uint64_t>(blockBytes, meta.dataSize - off);
+        int bits = FormatHandler::DetectPseudoFloat(PcmBytes(src, meta, off, want, scratch), want / 4, stride);
+        if (bits == 0)
+            return 0;
+        widest = std::max(widest, bits);
+    }
+    return (widest == 16) ? 1 : 2;
+}
+
+// --- DECODE PIPELINE ---
+static const size_t DECODE_BATCH_CHUNKS = 4; // Chunks decoded per output batch
+
+// --- STATISTICS ---
+// --stats prints the codec counters and per-stage times after a run, as a
+// histogram summary or (--stats=json) as one JSON object on its own line.
+enum class StatsMode
+{
+    Off,
+    Text,
+    Json
+};
+
+// Sums the time spent inside one pipeline stage; does nothing when off
+struct StageTimer
+{
+    bool on;
+    double seconds = 0;
+    std::chrono::steady_clock::time_point t0;
+
+    explicit StageTimer(bool enabled) : on(enabled) {}
+    void Start()
+    {
+        if (on)
+            t0 = std::chrono::steady_clock::now();
+    }
+    void Stop()
+    {
+        if (on)
+            seconds += VeloxCodec::SecondsSince(t0);
+    }
+};
+
+typedef std::vector<std::pair<const char *, double>> StageTimes;
+
+static void PrintHistogram(std::ostream &log, const char *title, const uint64_t *bins, size_t n)
+{
+    uint64_t total = 0, peak = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        total += bins[i];
+        peak = std::max(peak, bins[i]);
+    }
+    if (total == 0)
+        return;
+    log << "    " << title << ":\n";
+    for (size_t i = 0; i < n; i++)
+    {
+        if (bins[i] == 0)
+            continue;
+        log << "      " << std::setw(2) << i << " " << std::setw(12) << bins[i] << " " << std::setw(6)
+            << std::setprecision(1) << 100.0 * bins[i] / total << "% " << std::string((size_t)(30 * bins[i] / peak), '#')
+            << "\n";
+    }
+}
+
+static void PrintJsonBins(std::ostream &log, const char *name, const uint64_t *bins, size_t n)
+{
+    log << ",\"" << name << "\":{";
+    bool first = true;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (bins[i] == 0)
+            continue;
+        log << (first ? "" : ",") << "\"" << i << "\":" << bins[i];
+        first = false;
+    }
+    log << "}";
+}
+
+static void PrintStats(std::ostream &log, StatsMode mode, const char *run, const VeloxCodec::Stats &s,
+                       const StageTimes &stages)
+{
+    uint64_t residuals = 0, kSum = 0;
+    for (int k = 0; k < 64; k++)
+    {
+        residuals += s.rice_k[k];
+        kSum += s.rice_k[k] * (uint64_t)k;
+    }
+    double avgK = residuals ? (double)kSum / residuals : 0;
+    auto pct = [](uint64_t n, uint64_t of) { return of ? 100.0 * n / of : 0.0; };
 
-        std::cout << "[1] Loading Audio: " << metaInfo.sampleRate << "Hz / " << metaInfo.bitsPerSample << "bit";
-        if (metaInfo.isBigEndian)
-            std::cout << " (AIFF)";
-        std::cout << "\n";
+    log << std::fixed;
+    if (mode == StatsMode::Json)
+    {
+        log << "{\"run\":\"" << run << "\",\"chunks\":" << s.chunks << ",\"samples\":" << s.samples
+            << ",\"bytes\":" << s.bytes << ",\"raw_chunks\":" << s.raw_chunks
+            << ",\"high_res_chunks\":" << s.high_res_chunks << ",\"stereo\":{\"lr\":" << s.stereo[0]
+            << ",\"ms\":" << s.stereo[1] << ",\"ls\":" << s.stereo[2] << ",\"rs\":" << s.stereo[3]
+            << "},\"channels\":" << s.channels << ",\"silent_channels\":" << s.silent_channels
+            << ",\"neural_channels\":" << s.neural_channels;
+        PrintJsonBins(log, "lsb_shift", s.lsb_shift, 32);
+        PrintJsonBins(log, "lpc_order", s.lpc_order, VeloxCodec::MAX_LPC_ORDER + 1);
+        PrintJsonBins(log, "rice_k", s.rice_k, 64);
+        log << ",\"avg_rice_k\":" << std::setprecision(4) << avgK << ",\"escapes\":" << s.escapes
+            << ",\"seconds\":{";
+        for (size_t i = 0; i < stages.size(); i++)
+            log << (i ? "," : "") << "\"" << stages[i].first << "\":" << std::setprecision(6) << stages[i].second;
+        log << "}}\n";
+        return;
+    }
+
+    log << "[Stats] " << s.chunks << " chunks, " << s.samples << " samples, " << std::setprecision(2)
+        << s.bytes / 1e6 << " MB coded";
+    if (s.samples > 0)
+        log << " (" << 8.0 * s.bytes / s.samples << " bits/sample)";
+    log << "\n";
+    log << std::setprecision(1) << "    Raw fallback: " << s.raw_chunks << " chunks (" << pct(s.raw_chunks, s.chunks)
+        << "%), high-res: " << s.high_res_chunks << " chunks (" << pct(s.high_res_chunks, s.chunks) << "%)\n";
+    uint64_t stereoChunks = s.stereo[0] + s.stereo[1] + s.stereo[2] + s.stereo[3];
+    if (stereoChunks > 0)
+    {
+        static const char *names[] = {"L/R", "M/S", "L/S", "R/S"};
+        log << "    Stereo:";
+        for (int i = 0; i < 4; i++)
+            log << (i ? ", " : " ") << names[i] << " " << s.stereo[i] << " (" << pct(s.stereo[i], stereoChunks) << "%)";
+        log << "\n";
+    }
+    log << "    Channel blocks: " << s.channels << ", silent " << s.silent_channels << " ("
+        << pct(s.silent_channels, s.channels) << "%), neural " << s.neural_channels << " ("
+        << pct(s.neural_channels, s.channels) << "%)\n";
+    PrintHistogram(log, "LSB shift", s.lsb_shift, 32);
+    PrintHistogram(log, "LPC order", s.lpc_order, VeloxCodec::MAX_LPC_ORDER + 1);
+    std::ostringstream kTitle;
+    kTitle << std::fixed << std::setprecision(2) << "Rice k (avg " << avgK << ", escapes " << s.escapes << " = "
+           << std::setprecision(4) << pct(s.escapes, residuals) << "%)";
+    PrintHistogram(log, kTitle.str().c_str(), s.rice_k, 64);
+    log << "    Time (s):";
+    for (size_t i = 0; i < stages.size(); i++)
+        log << (i ? ", " : " ") << stages[i].first << " " << std::setprecision(3) << stages[i].second;
+    log << "\n";
+}
+
+// --- FILE JOBS ---
+struct EncodeOptions
+{
+    VeloxCodec::Level level = VeloxCodec::Level::Default;
+    std::string artist; // Empty: imported from the file's tags
+    std::string title;
+    StatsMode stats = StatsMode::Off;
+};
 
-        // 2. Auto-import tags if user didn't provide them
-        if (!userProvidedTags)
+struct FileResult
+{
+    uint64_t inBytes = 0;
+    uint64_t outBytes = 0;
+    uint64_t pcmBytes = 0; // Audio data size, for throughput
+    double seconds = 0;
+    std::string error;
+    VeloxCodec::Stats stats; // Codec counters and stage times (with stats on)
+    StageTimes stages;
+};
+
+// What EncodePayload leaves for EncodeFile to finish the file with
+struct EncodedPayload
+{
+    uint64_t samples = 0;                  // Samples encoded
+    uint64_t bytes = 0;                    // Stream bytes written
+    uint64_t pcmBytes = 0;                 // PCM bytes read
+    std::vector<VeloxSeekPoint> seekTable; // Relative to the first stream byte
+    VeloxCodec::Stats stats;               // Encoder counters (with stats on)
+};
+
+// Compressed Data: a reader thread loads and converts PCM blocks, pool
+// workers encode chunks, and a writer thread appends them to 'out' in
+// order. Bounded queues keep disk reads, encoding and disk writes
+// overlapped without buffering the whole file. Sample is the encoder's
+// sample type: int32_t holds any integer source of up to 24 bits at half
+// the memory traffic, velox_sample_t holds everything. A piped input's
+// footer goes to 'footerBlob'.
+template <class Sample>
+static EncodedPayload EncodePayload(MappedFile &src, const AudioMetadata &metaInfo, bool pipeIn, bool isFloat,
+                                    int floatMode, VeloxCodec::Level level, bool withStats, std::ostream &out,
+                                    std::vector<uint8_t> &footerBlob, StageTimer &readTimer, StageTimer &writeTimer)
+{
+    BoundedQueue<PcmBlock<Sample>> readQueue(READ_AHEAD_BLOCKS);
+    uint64_t pcmBytes = pipeIn ? 0 : metaInfo.dataSize;
+    std::thread reader([&]()
+                       {
+        // Reading and converting count; waiting on a full queue does not
+        readTimer.Start();
+        auto push = [&](const uint8_t *raw, size_t bytes)
+        {
+            PcmBlock<Sample> block;
+            if (floatMode != 0)
+                FormatHandler::DemoteFloatToInt(raw, bytes / 4, floatMode == 1 ? 16 : 24, block.samples);
+            else if (isFloat)
+                FormatHandler::SplitFloat32(raw, bytes / 4, block.samples, block.exps);
+            else
+                FormatHandler::BytesToSamples(raw, bytes / (metaInfo.bitsPerSample / 8), metaInfo.bitsPerSample, block.samples);
+            readTimer.Stop();
+            bool ok = readQueue.Push(std::move(block));
+            readTimer.Start();
+            return ok;
+        };
+        if (pipeIn)
         {
-            VeloxMetadata importedMeta;
-            if (TagBridge::ImportTags(inF, importedMeta))
+            pcmBytes = PipePcm(std::cin, metaInfo, push, footerBlob);
+        }
+        else
+        {
+            std::vector<uint8_t> scratch;
+            size_t blockBytes = PcmBlockBytes(metaInfo);
+            for (uint64_t off = 0; off < metaInfo.dataSize; off += blockBytes)
             {
-                std::string a = importedMeta.GetTag("ARTIST");
-                std::string t = importedMeta.GetTag("TITLE");
-                if (!a.empty())
-                    metaArtist = a;
-                if (!t.empty())
-                    metaTitle = t;
-                std::cout << "    -> Auto-Tag: " << metaTitle << " by " << metaArtist << "\n";
+                // Page in the following block while this one is converted
+                size_t want = (size_t)std::min<uint64_t>(blockBytes, metaInfo.dataSize - off);
+                src.WillNeed((size_t)(metaInfo.dataPos + off + want), blockBytes);
+                if (!push(PcmBytes(src, metaInfo, off, want, scratch), want))
+                    break;
             }
         }
+        readTimer.Stop();
+        readQueue.Close(); });
 
-        // 3. Read raw PCM data
-        std::ifstream in(inF, std::ios::binary);
-        std::vector<uint8_t> raw(metaInfo.dataSize);
-        in.seekg(metaInfo.dataPos);
-        in.read((char *)raw.data(), metaInfo.dataSize);
+    // Batches come from the BufferPool and go back once written, so the
+    // sink and the writer cycle a few buffers instead of allocating
+    BoundedQueue<std::vector<uint8_t>> writeQueue(WRITE_QUEUE_BATCHES);
+    std::thread writer([&]()
+                       {
+        std::vector<uint8_t> bytes;
+        while (writeQueue.Pop(bytes))
+        {
+            writeTimer.Start();
+            out.write((const char *)bytes.data(), bytes.size());
+            writeTimer.Stop();
+            BufferPool::Return(std::move(bytes));
+        } });
 
-        // 4. Handle endianness (if AIFF)
-        if (metaInfo.isBigEndian)
+    std::vector<uint8_t> batch = BufferPool::Borrow(2 * WRITE_BATCH_BYTES);
+    VeloxCodec::BasicStreamEncoder<Sample> encoder([&](const uint8_t *data, size_t size)
+                                                   {
+        batch.insert(batch.end(), data, data + size);
+        if (batch.size() >= WRITE_BATCH_BYTES)
         {
-            if (metaInfo.bitsPerSample == 16)
-                EndianUtils::SwapBuffer16(raw.data(), raw.size());
-            else if (metaInfo.bitsPerSample == 24)
-                EndianUtils::SwapBuffer24(raw.data(), raw.size());
-            else if (metaInfo.bitsPerSample == 32)
-                EndianUtils::SwapBuffer32(raw.data(), raw.size());
-        }
+            writeQueue.Push(std::move(batch));
+            batch = BufferPool::Borrow(2 * WRITE_BATCH_BYTES);
+        } },
+                                                   metaInfo.channels, isFloat, floatMode, level);
+    if (withStats)
+        encoder.CollectStats();
+    if (!pipeIn)
+        encoder.ReserveSeekTable(metaInfo.dataSize / std::max(metaInfo.bitsPerSample / 8, 1));
+    PcmBlock<Sample> block;
+    while (readQueue.Pop(block))
+        encoder.Push(block.samples.data(), block.exps.data(), block.samples.size());
+    encoder.Close();
+    writeQueue.Push(std::move(batch));
+    writeQueue.Close();
+    reader.join();
+    writer.join();
 
-        // 5. Prepare compression
-        std::vector<velox_sample_t> samples;
-        std::vector<uint8_t> exponents;
-        bool isFloat = (metaInfo.formatCode == 3);
+    EncodedPayload payload;
+    payload.samples = encoder.GetTotalSamples();
+    payload.bytes = encoder.GetBytesWritten();
+    payload.pcmBytes = pcmBytes;
+    payload.seekTable = encoder.GetSeekTable();
+    if (withStats)
+        payload.stats = *encoder.GetStats();
+    return payload;
+}
 
-        if (isFloat)
-            FormatHandler::SplitFloat32(raw.data(), raw.size() / 4, samples, exponents);
-        else
-            FormatHandler::BytesToSamples(raw.data(), raw.size() / (metaInfo.bitsPerSample / 8), metaInfo.bitsPerSample, samples);
-
-        std::cout << "[2] Compressing...\n";
-        VeloxCodec::Encoder encoder;
-        auto compData = encoder.ProcessBlock(samples, isFloat, exponents, raw.data());
-
-        // 6. Write .VLX file
-        std::ofstream out(outF, std::ios::binary);
-
-        // Header
-        bool hasPadding = (raw.size() % 2 != 0);
-        uint16_t bits_flag = metaInfo.bitsPerSample;
-        if (hasPadding)
-            bits_flag |= 0x8000;
-
-        // Handle header blob:
-        // - If WAV: Copy original header to preserve unknown metadata.
-        // - If AIFF: Generate new WAV header (Velox decompresses to WAV, not AIFF).
-        std::vector<uint8_t> headerBlob;
-        if (metaInfo.isBigEndian)
+// Encodes one WAV/AIFF file, reporting progress to 'log'. "-" reads the
+// input from stdin or writes the .vlx to stdout. Either way the header
+// cannot be finished before the data, so the file ends with a trailer.
+static bool EncodeFile(const std::string &inF, const std::string &outF, const EncodeOptions &opts, std::ostream &log,
+                       FileResult &res)
+{
+    bool pipeIn = (inF == "-");
+    bool pipeOut = (outF == "-");
+    bool trailing = pipeIn || pipeOut;
+
+    // 1. Analyze input file (WAV/AIFF)
+    MappedFile src;
+    std::vector<uint8_t> pipeHead; // Piped input up to the first audio byte
+    AudioMetadata metaInfo;
+    bool parsed = pipeIn ? AudioLoader::ParseStream(std::cin, metaInfo, pipeHead)
+                         : src.Open(inF) && AudioLoader::DetectAndParse(src.Data(), src.Size(), metaInfo);
+    if (!parsed)
+    {
+        res.error = "Error: Unsupported format or invalid file.";
+        return false;
+    }
+
+    log << "[1] Loading Audio: " << metaInfo.sampleRate << "Hz / " << metaInfo.bitsPerSample << "bit";
+    if (metaInfo.isBigEndian)
+        log << " (AIFF)";
+    log << "\n";
+
+    // 2. Auto-import tags if user didn't provide them
+    std::string metaArtist = opts.artist.empty() ? "Unknown Artist" : opts.artist;
+    std::string metaTitle = opts.title.empty() ? (pipeIn ? "Unknown Title" : GetFileName(inF)) : opts.title;
+    if (opts.artist.empty() && opts.title.empty() && !pipeIn)
+    {
+        VeloxMetadata importedMeta;
+        if (TagBridge::ImportTags(inF, importedMeta))
         {
-            headerBlob = GenerateWavHeader(metaInfo.sampleRate, metaInfo.channels, metaInfo.bitsPerSample, metaInfo.dataSize, isFloat);
+            std::string a = importedMeta.GetTag("ARTIST");
+            std::string t = importedMeta.GetTag("TITLE");
+            if (!a.empty())
+                metaArtist = a;
+            if (!t.empty())
+                metaTitle = t;
+            log << "    -> Auto-Tag: " << metaTitle << " by " << metaArtist << "\n";
         }
-        else
+    }
+
+    // 3. Scan float data: the stream prefix records whether the floats
+    // are really 16/24-bit integers, so that is settled before encoding.
+    // A pipe cannot be scanned ahead; its floats keep their exponents.
+    bool isFloat = (metaInfo.formatCode == 3);
+    int floatMode = 0;
+    if (!pipeIn)
+    {
+        src.AdviseSequential();
+        floatMode = isFloat ? ScanFloatMode(src, metaInfo) : 0;
+    }
+
+    // 6. Write .VLX file
+    std::ofstream file;
+    if (!pipeOut)
+    {
+        file.open(outF, std::ios::binary);
+        if (!file)
         {
-            headerBlob.resize(metaInfo.dataPos);
-            in.seekg(0);
-            in.read((char *)headerBlob.data(), metaInfo.dataPos);
+            res.error = "Error: Cannot write " + outF;
+            return false;
         }
+    }
+    std::ostream &out = pipeOut ? std::cout : file;
 
-        std::vector<uint8_t> footerBlob;
+    // Header
+    bool hasPadding = (metaInfo.dataSize % 2 != 0) && !(pipeIn && PipeOpenEnded(metaInfo));
+    uint16_t bits_flag = metaInfo.bitsPerSample;
+    if (hasPadding)
+        bits_flag |= 0x8000;
 
-        if (!metaInfo.isBigEndian)
-        { // Only WAV files have footer blocks to preserve
-            // Calculate footer start position
-            // dataPos + dataSize + padding
-            uint32_t footerStart = metaInfo.dataPos + metaInfo.dataSize + (metaInfo.dataSize % 2);
+    // Handle header blob:
+    // - If WAV: Copy original header to preserve unknown metadata.
+    // - If AIFF: Generate new WAV header (Velox decompresses to WAV, not AIFF).
+    std::vector<uint8_t> headerBlob;
+    if (metaInfo.isBigEndian)
+    {
+        headerBlob = GenerateWavHeader(metaInfo.sampleRate, metaInfo.channels, metaInfo.bitsPerSample, metaInfo.dataSize, isFloat);
+    }
+    else if (pipeIn)
+    {
+        headerBlob = pipeHead;
+    }
+    else
+    {
+        headerBlob.assign(src.Data(), src.Data() + std::min<size_t>(metaInfo.dataPos, src.Size()));
+        headerBlob.resize(metaInfo.dataPos);
+    }
 
-            // Calculate original file size
-            in.seekg(0, std::ios::end);
-            uint32_t fileSize = (uint32_t)in.tellg();
+    // A piped input's footer is only known once the data is read
+    std::vector<uint8_t> footerBlob;
 
-            if (fileSize > footerStart)
-            {
-                uint32_t footerLen = fileSize - footerStart;
-                footerBlob.resize(footerLen);
-                in.seekg(footerStart);
-                in.read((char *)footerBlob.data(), footerLen);
-            }
-        }
+    if (!metaInfo.isBigEndian && !pipeIn)
+    { // Only WAV files have footer blocks to preserve
+        // Calculate footer start position
+        // dataPos + dataSize + padding
+        uint32_t footerStart = metaInfo.dataPos + metaInfo.dataSize + (metaInfo.dataSize % 2);
 
-        // Update header with actual footer size
-        VeloxHeader vh = {
-            0x584C4556, 0x0800,
-            metaInfo.sampleRate, metaInfo.channels,
-            bits_flag, metaInfo.formatCode,
-            (uint64_t)samples.size(),
-            (uint32_t)headerBlob.size(),
-            (uint32_t)footerBlob.size()};
-        out.write((char *)&vh, sizeof(vh));
+        if (src.Size() > footerStart)
+            footerBlob.assign(src.Data() + footerStart, src.Data() + src.Size());
+    }
 
-        // Metadata Block
-        VeloxMetadata meta;
-        meta.SetTag("ARTIST", metaArtist);
-        meta.SetTag("TITLE", metaTitle);
-        meta.SetTag("ENCODER", "Velox v1.1");
-        meta.WriteToStream(out);
-
-        // Raw Header Blob
-        out.write((char *)headerBlob.data(), headerBlob.size());
-        // Footer Blob
+    // Sample count and seek table are patched in once the stream is closed
+    // (or left to the trailer when writing to a pipe)
+    VeloxHeader vh = {
+        0x584C4556, VELOX_VERSION,
+        metaInfo.sampleRate, metaInfo.channels,
+        bits_flag, metaInfo.formatCode,
+        trailing ? VELOX_SAMPLES_UNKNOWN : 0,
+        (uint32_t)headerBlob.size(),
+        trailing ? VELOX_BLOB_TRAILING : (uint32_t)footerBlob.size(),
+        0, 0};
+    out.write((char *)&vh, sizeof(vh));
+
+    // Metadata Block
+    VeloxMetadata meta;
+    meta.SetTag("ARTIST", metaArtist);
+    meta.SetTag("TITLE", metaTitle);
+    meta.SetTag("ENCODER", "Velox v1.1");
+    std::ostringstream metaBlock;
+    meta.WriteToStream(metaBlock);
+    std::string metaBytes = metaBlock.str();
+    out.write(metaBytes.data(), metaBytes.size());
+
+    // Raw Header Blob
+    out.write((char *)headerBlob.data(), headerBlob.size());
+    // Footer Blob
+    if (!trailing)
         out.write((char *)footerBlob.data(), footerBlob.size());
 
-        // Compressed Data
-        out.write((char *)compData.data(), compData.size());
+    // Compressed Data (see EncodePayload)
+    static const char *levelNames[] = {"fast", "default", "max"};
+    log << "[2] Compressing (" << levelNames[(int)opts.level] << ")...\n";
+    auto encStart = std::chrono::steady_clock::now();
+    uint64_t compStart = sizeof(vh) + metaBytes.size() + headerBlob.size() + (trailing ? 0 : footerBlob.size());
 
-        float ratio = 100.0f * (float)out.tellp() / (float)(metaInfo.dataSize + headerBlob.size());
-        std::cout << "Done! Ratio: " << std::fixed << std::setprecision(2) << ratio << "%\n";
+    bool withStats = (opts.stats != StatsMode::Off);
+    StageTimer readTimer(withStats), writeTimer(withStats);
+    // Integer sources of up to 24 bits (pseudo-floats included) encode
+    // from 32-bit samples
+    EncodedPayload payload;
+    if (isFloat ? floatMode != 0 : metaInfo.bitsPerSample <= 24)
+        payload = EncodePayload<int32_t>(src, metaInfo, pipeIn, isFloat, floatMode, opts.level, withStats, out,
+                                         footerBlob, readTimer, writeTimer);
+    else
+        payload = EncodePayload<velox_sample_t>(src, metaInfo, pipeIn, isFloat, floatMode, opts.level, withStats,
+                                                out, footerBlob, readTimer, writeTimer);
+    double encSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - encStart).count();
+    vh.total_samples = payload.samples;
+
+    // A trailing file marks the end of its chunks with a zero-size one
+    uint64_t tablePos = compStart + payload.bytes;
+    if (trailing)
+    {
+        uint32_t endChunk[2] = {0, 0};
+        out.write((char *)endChunk, sizeof(endChunk));
+        tablePos += sizeof(endChunk);
     }
 
-    // --- DECODE MODE ---
-    else if (mode == "-d")
+    // Seek table: one point per chunk, rebased to file offsets. The
+    // header only has 32-bit fields, so past 4 GB only a trailer has it.
+    const auto &seekTable = payload.seekTable;
+    uint32_t tableCount = 0;
+    if (!seekTable.empty() && (trailing || tablePos <= 0xFFFFFFFFull))
     {
-        std::ifstream in(inF, std::ios::binary);
-        if (!in.is_open())
+        for (VeloxSeekPoint sp : seekTable)
         {
-            std::cerr << "Error open input\n";
-            return 1;
+            sp.byte_offset += compStart;
+            out.write((char *)&sp, sizeof(sp));
         }
-
-        VeloxHeader vh;
-        in.read((char *)&vh, sizeof(vh));
-        if (vh.magic != 0x584C4556)
+        tableCount = (uint32_t)seekTable.size();
+        if (tablePos <= 0xFFFFFFFFull)
         {
-            std::cerr << "Invalid File\n";
-            return 1;
+            vh.seek_table_offset = (uint32_t)tablePos;
+            vh.seek_table_count = tableCount;
         }
+    }
+    res.outBytes = tablePos + (uint64_t)tableCount * sizeof(VeloxSeekPoint);
 
-        bool hasPadding = (vh.bits_per_sample & 0x8000) != 0;
-        uint16_t realBits = vh.bits_per_sample & 0x7FFF;
+    if (trailing)
+    {
+        VeloxTrailer trailer = {VELOX_TRAILER_MAGIC, vh.total_samples, (uint32_t)footerBlob.size(), tableCount};
+        out.write((char *)footerBlob.data(), footerBlob.size());
+        out.write((char *)&trailer, sizeof(trailer));
+        res.outBytes += footerBlob.size() + sizeof(trailer);
+    }
 
-        if (vh.version >= 0x0400)
+    res.inBytes = payload.pcmBytes + headerBlob.size();
+    res.pcmBytes = payload.pcmBytes;
+    res.seconds = encSeconds;
+    float ratio = 100.0f * (float)res.outBytes / (float)std::max<uint64_t>(res.inBytes, 1);
+    log << "Done! Ratio: " << std::fixed << std::setprecision(2) << ratio << "%";
+    if (encSeconds > 0)
+        log << " (" << std::setprecision(1) << payload.pcmBytes / encSeconds / 1e6 << " MB/s)";
+    log << "\n";
+    if (withStats)
+    {
+        const VeloxCodec::Stats &stats = payload.stats;
+        res.stats = stats;
+        res.stages = {{"read", readTimer.seconds}, {"analysis", stats.analysis_seconds},
+                      {"coding", stats.coding_seconds}, {"write", writeTimer.seconds}, {"wall", encSeconds}};
+        PrintStats(log, opts.stats, "encode", stats, res.stages);
+    }
+
+    // A file still gets the final header; a pipe relies on the trailer
+    if (pipeOut)
+    {
+        out.flush();
+    }
+    else
+    {
+        out.seekp(0);
+        out.write((char *)&vh, sizeof(vh));
+    }
+    if (!out)
+    {
+        res.error = "Error: Cannot write " + outF;
+        return false;
+    }
+    return true;
+}
+
+// What DecodePayload leaves for DecodeFile to finish the output with
+struct DecodedPayload
+{
+    uint64_t samples = 0;       // Fewer than the stream's total if it is damaged
+    size_t bytesPerSample = 0;  // Of the PCM queued
+    size_t batchSamples = 0;    // Largest batch queued
+    VeloxCodec::Stats stats;    // Decoder counters (with stats on)
+};
+
+// Decodes the payload that starts at 'pos' (or on stdin) a batch of whole
+// chunks at a time and queues each batch as PCM for the writer. Sample is
+// the decoder's sample type: int32_t holds any integer source of up to 24
+// bits at half the memory traffic, velox_sample_t holds everything.
+template <class Sample>
+static DecodedPayload DecodePayload(const MappedFile &in, size_t pos, bool pipeIn, const VeloxHeader &vh,
+                                    uint64_t totalSamples, bool withStats,
+                                    BoundedQueue<std::vector<uint8_t>> &writeQueue, StageTimer &decodeTimer,
+                                    StageTimer &convertTimer)
+{
+    typedef VeloxCodec::BasicStreamingDecoder<Sample> Decoder;
+    uint16_t realBits = vh.bits_per_sample & 0x7FFF;
+    // Piped streams are pulled chunk by chunk, except VELOX_VERSION_LEGACY
+    // ones, whose prefix may hold a whole-stream exponent block; those are
+    // read in full first
+    std::vector<uint8_t> buffered;
+    std::unique_ptr<Decoder> decoder;
+    if (!pipeIn)
+    {
+        decoder.reset(new Decoder(in.Data() + pos, in.Size() - pos, totalSamples, vh.version, vh.channels));
+    }
+    else if (vh.version >= VELOX_VERSION_FRAMED)
+    {
+        auto source = [](uint8_t *p, size_t n)
         {
-            VeloxMetadata meta;
-            if (meta.ReadFromStream(in))
-            {
-                std::cout << "[Metadata] " << meta.GetTag("TITLE") << " - " << meta.GetTag("ARTIST") << "\n";
-            }
-        }
+            std::cin.read((char *)p, n);
+            return (size_t)std::cin.gcount();
+        };
+        decoder.reset(new Decoder(source, totalSamples, vh.channels));
+    }
+    else
+    {
+        buffered = ReadPipe(std::cin, UINT64_MAX);
+        decoder.reset(new Decoder(buffered.data(), buffered.size(), totalSamples, vh.version, vh.channels));
+    }
+    decoder->SetDecodeAhead(2 * std::max(1u, std::thread::hardware_concurrency()));
+    if (withStats)
+        decoder->CollectStats();
 
-        std::vector<uint8_t> hData(vh.header_blob_size);
-        in.read((char *)hData.data(), vh.header_blob_size);
+    // Auto-promote logic
+    int fMode = (vh.format_code == 3 && !decoder->IsFloat()) ? decoder->GetFloatMode() : 0;
+    bool promote = (fMode == 1 || fMode == 2);
+    size_t outBytesPerSample = (decoder->IsFloat() || promote) ? 4 : realBits / 8;
 
-        // Read Footer
-        std::vector<uint8_t> fData(vh.footer_blob_size);
-        in.read((char *)fData.data(), vh.footer_blob_size);
+    size_t capacity = decoder->MaxChunkSamples() * DECODE_BATCH_CHUNKS;
+    std::vector<Sample> outSamples(capacity);
+    std::vector<uint8_t> outExponents(capacity);
+    uint64_t decodedPos = 0;
+    while (decodedPos < totalSamples)
+    {
+        decodeTimer.Start();
+        size_t n = decoder->DecodeFrames(outSamples.data(), outExponents.data(), capacity);
+        decodeTimer.Stop();
+        if (n == 0)
+            break;
+        decodedPos += n;
 
-        std::cout << "[2] Decoding...\n";
-        std::vector<uint8_t> compData((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        // The decode buffers stay at capacity; only the first n are converted
+        convertTimer.Start();
+        std::vector<uint8_t> rawBytes = BufferPool::Borrow(n * outBytesPerSample);
+        if (decoder->IsFloat())
+            FormatHandler::MergeFloat32(outSamples.data(), outExponents.data(), n, rawBytes);
+        else if (promote) // Pseudo-float handling
+            FormatHandler::PromoteIntToFloat(outSamples.data(), n, fMode == 1 ? 16 : 24, rawBytes);
+        else
+            FormatHandler::SamplesToBytes(outSamples.data(), n, realBits, rawBytes);
+        convertTimer.Stop();
+        writeQueue.Push(std::move(rawBytes));
+    }
 
-        VeloxCodec::StreamingDecoder decoder(compData.data(), compData.size(), vh.total_samples);
-        std::vector<velox_sample_t> outSamples(vh.total_samples);
-        std::vector<uint8_t> outExponents(vh.total_samples);
+    DecodedPayload payload;
+    payload.samples = decodedPos;
+    payload.bytesPerSample = outBytesPerSample;
+    payload.batchSamples = capacity;
+    if (withStats)
+        payload.stats = *decoder->GetStats();
+    return payload;
+}
 
-        for (size_t i = 0; i < vh.total_samples; i++)
+// Decodes one .vlx file to WAV. "-" reads the .vlx from stdin, pulling
+// chunks as they arrive, or writes the WAV to stdout.
+static bool DecodeFile(const std::string &inF, const std::string &outF, std::ostream &log, FileResult &res,
+                       StatsMode statsMode = StatsMode::Off)
+{
+    bool pipeIn = (inF == "-");
+    bool pipeOut = (outF == "-");
+
+    // A file's payload is decoded in place from the mapping
+    MappedFile in;
+    if (!pipeIn)
+    {
+        if (!in.Open(inF))
         {
-            if (!decoder.DecodeNext(outSamples[i], outExponents[i]))
-                break;
+            res.error = "Error open input";
+            return false;
         }
+        in.AdviseSequential();
+    }
 
-        std::cout << "[3] Writing WAV...\n";
-        std::vector<uint8_t> rawBytes;
+    VeloxHeader vh;
+    std::vector<uint8_t> head = pipeIn ? ReadPipe(std::cin, sizeof(vh)) : std::vector<uint8_t>();
+    const uint8_t *headPtr = pipeIn ? head.data() : in.Data();
+    size_t headSize = pipeIn ? head.size() : in.Size();
+    if (headSize < sizeof(vh))
+    {
+        res.error = "Invalid File";
+        return false;
+    }
+    memcpy(&vh, headPtr, sizeof(vh));
+    if (vh.magic != 0x584C4556)
+    {
+        res.error = "Invalid File";
+        return false;
+    }
+    size_t pos = sizeof(vh);
 
-        // Auto-promote logic
-        if (decoder.IsFloat())
+    bool hasPadding = (vh.bits_per_sample & 0x8000) != 0;
+    uint16_t realBits = vh.bits_per_sample & 0x7FFF;
+    bool trailing = (vh.footer_blob_size == VELOX_BLOB_TRAILING);
+
+    if (vh.version >= 0x0400)
+    {
+        VeloxMetadata meta;
+        size_t metaSize = 0;
+        bool found = pipeIn ? meta.ReadFromStream(std::cin) : meta.ReadFromMemory(in.Data() + pos, in.Size() - pos, metaSize);
+        if (found)
         {
-            FormatHandler::MergeFloat32(outSamples, outExponents, rawBytes);
+            log << "[Metadata] " << meta.GetTag("TITLE") << " - " << meta.GetTag("ARTIST") << "\n";
         }
-        else
+        pos += metaSize;
+    }
+
+    // Header and footer blobs. A trailing file keeps its footer at the end.
+    std::vector<uint8_t> hData, fData;
+    VeloxTrailer trailer = {};
+    uint64_t totalSamples = vh.total_samples;
+    if (pipeIn)
+    {
+        hData = ReadPipe(std::cin, vh.header_blob_size);
+        hData.resize(vh.header_blob_size);
+        if (!trailing)
         {
-            if (vh.format_code == 3)
-            { // Pseudo-float handling
-                int fMode = decoder.GetFloatMode();
-                if (fMode == 1)
-                    FormatHandler::PromoteIntToFloat(outSamples, 16, rawBytes);
-                else if (fMode == 2)
-                    FormatHandler::PromoteIntToFloat(outSamples, 24, rawBytes);
-                else
-                    FormatHandler::SamplesToBytes(outSamples, realBits, rawBytes);
-            }
-            else
+            fData = ReadPipe(std::cin, vh.footer_blob_size);
+            fData.resize(vh.footer_blob_size);
+        }
+    }
+    else
+    {
+        size_t hSize = std::min<size_t>(vh.header_blob_size, in.Size() - pos);
+        hData.assign(in.Data() + pos, in.Data() + pos + hSize);
+        hData.resize(vh.header_blob_size);
+        pos += hSize;
+        if (trailing)
+        {
+            if (!ReadVeloxTrailer(in.Data(), in.Size(), trailer))
             {
-                FormatHandler::SamplesToBytes(outSamples, realBits, rawBytes);
+                res.error = "Invalid File";
+                return false;
             }
+            if (totalSamples == VELOX_SAMPLES_UNKNOWN)
+                totalSamples = trailer.total_samples;
+            const uint8_t *footer = in.Data() + VeloxTrailerFooterOffset(in.Size(), trailer);
+            fData.assign(footer, footer + trailer.footer_blob_size);
+        }
+        else
+        {
+            size_t fSize = std::min<size_t>(vh.footer_blob_size, in.Size() - pos);
+            fData.assign(in.Data() + pos, in.Data() + pos + fSize);
+            fData.resize(vh.footer_blob_size);
+            pos += fSize;
         }
+    }
 
-        std::ofstream out(outF, std::ios::binary);
-        // Write header (original header or header generated during compression)
-        out.write((char *)hData.data(), hData.size());
-        out.write((char *)rawBytes.data(), rawBytes.size());
-        if (hasPadding)
+    log << "[2] Decoding...\n";
+    auto decStart = std::chrono::steady_clock::now();
+    bool withStats = (statsMode != StatsMode::Off);
+    StageTimer decodeTimer(withStats), convertTimer(withStats), writeTimer(withStats);
+
+    std::ofstream file;
+    if (!pipeOut)
+    {
+        file.open(outF, std::ios::binary);
+        if (!file)
         {
-            char z = 0;
-            out.write(&z, 1);
+            res.error = "Error: Cannot write " + outF;
+            return false;
         }
-        out.write((char *)fData.data(), fData.size());
-        std::cout << "Done: " << outF << "\n";
+    }
+    std::ostream &out = pipeOut ? std::cout : file;
+    // Write header (original header or header generated during compression)
+    out.write((char *)hData.data(), hData.size());
+
+    // Whole chunks are decoded a batch at a time, converted to PCM into a
+    // pooled buffer and handed to a writer thread, which returns it to the
+    // BufferPool. Memory stays at a few batches and disk writes overlap
+    // decoding
+    BoundedQueue<std::vector<uint8_t>> writeQueue(WRITE_QUEUE_BATCHES);
+    std::thread writer([&]()
+                       {
+        std::vector<uint8_t> bytes;
+        while (writeQueue.Pop(bytes))
+        {
+            writeTimer.Start();
+            out.write((const char *)bytes.data(), bytes.size());
+            writeTimer.Stop();
+            BufferPool::Return(std::move(bytes));
+        } });
+
+    // Integer sources of up to 24 bits decode into 32-bit samples
+    DecodedPayload payload;
+    if (vh.format_code != 3 && realBits <= 24)
+        payload = DecodePayload<int32_t>(in, pos, pipeIn, vh, totalSamples, withStats, writeQueue, decodeTimer,
+                                         convertTimer);
+    else
+        payload = DecodePayload<velox_sample_t>(in, pos, pipeIn, vh, totalSamples, withStats, writeQueue, decodeTimer,
+                                                convertTimer);
+    uint64_t decodedPos = payload.samples;
+    size_t outBytesPerSample = payload.bytesPerSample;
+
+    // A piped trailing file ends with the seek table, footer and trailer
+    if (pipeIn && trailing)
+    {
+        std::vector<uint8_t> rest = ReadPipe(std::cin, UINT64_MAX);
+        if (ReadVeloxTrailer(rest.data(), rest.size(), trailer))
+        {
+            if (totalSamples == VELOX_SAMPLES_UNKNOWN)
+                totalSamples = trailer.total_samples;
+            auto footer = rest.begin() + (size_t)VeloxTrailerFooterOffset(rest.size(), trailer);
+            fData.assign(footer, footer + trailer.footer_blob_size);
+        }
+        else if (totalSamples == VELOX_SAMPLES_UNKNOWN)
+        {
+            totalSamples = decodedPos;
+        }
+    }
+
+    // A damaged stream still yields total_samples of output, the
+    // undecoded part as silence
+    while (decodedPos < totalSamples)
+    {
+        size_t n = (size_t)std::min<uint64_t>(payload.batchSamples, totalSamples - decodedPos);
+        std::vector<uint8_t> silence = BufferPool::Borrow(n * outBytesPerSample);
+        silence.resize(n * outBytesPerSample, 0);
+        writeQueue.Push(std::move(silence));
+        decodedPos += n;
+    }
+    writeQueue.Close();
+    writer.join();
+
+    if (hasPadding)
+    {
+        char z = 0;
+        out.write(&z, 1);
+    }
+    out.write((char *)fData.data(), fData.size());
+    out.flush();
+    res.inBytes = in.Size();
+    res.pcmBytes = totalSamples * outBytesPerSample;
+    res.outBytes = hData.size() + res.pcmBytes + (hasPadding ? 1 : 0) + fData.size();
+    res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - decStart).count();
+    log << "Done: " << outF << "\n";
+    // 'decode' is the time spent waiting on the decoder, 'coding' the
+    // decode work itself summed over the pool
+    if (withStats)
+    {
+        res.stats = payload.stats;
+        res.stages = {{"decode", decodeTimer.seconds}, {"coding", payload.stats.coding_seconds},
+                      {"convert", convertTimer.seconds}, {"write", writeTimer.seconds}, {"wall", res.seconds}};
+        PrintStats(log, statsMode, "decode", res.stats, res.stages);
+    }
+    if (!out)
+    {
+        res.error = "Error: Cannot write " + outF;
+        return false;
+    }
+    return true;
+}
+
+// --- BATCH MODE ---
+// Encodes (or decodes) every matching file of a directory into another one.
+// 'jobs' files are in flight at once on their own driver threads, while all
+// chunk work goes to the one shared pool. That keeps the workers busy while
+// one file drains its last chunks or writes its header. With --stats the
+// per-file counters and stage times are summed into one report at the end.
+static std::string Lower(std::string s)
+{
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c)
+                   { return (char)std::tolower(c); });
+    return s;
+}
+
+static int RunBatch(bool encode, const std::string &inDir, const std::string &outDir, size_t jobs,
+                    const EncodeOptions &opts)
+{
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    std::vector<fs::path> inputs;
+    for (const auto &entry : fs::directory_iterator(inDir, ec))
+    {
+        std::string ext = Lower(entry.path().extension().string());
+        bool match = encode ? (ext == ".wav" || ext == ".aif" || ext == ".aiff") : (ext == ".vlx");
+        if (match && entry.is_regular_file(ec))
+            inputs.push_back(entry.path());
+    }
+    std::sort(inputs.begin(), inputs.end());
+    if (inputs.empty())
+    {
+        std::cerr << "Error: No " << (encode ? "WAV/AIFF" : "VLX") << " files in " << inDir << "\n";
+        return 1;
+    }
+    fs::create_directories(outDir, ec);
+
+    std::cout << "[Batch] " << inputs.size() << " files, " << jobs << " at a time\n";
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<size_t> next{0};
+    std::mutex printMutex;
+    FileResult total;
+    size_t failed = 0;
+
+    auto drive = [&]()
+    {
+        std::ostream quiet(nullptr); // Per-file progress is dropped
+        for (size_t i; (i = next++) < inputs.size();)
+        {
+            fs::path outPath = fs::path(outDir) / inputs[i].stem();
+            outPath += encode ? ".vlx" : ".wav";
+            FileResult res;
+            bool ok = encode ? EncodeFile(inputs[i].string(), outPath.string(), opts, quiet, res)
+                             : DecodeFile(inputs[i].string(), outPath.string(), quiet, res, opts.stats);
+
+            std::lock_guard<std::mutex> lock(printMutex);
+            std::cout << "  " << inputs[i].filename().string() << ": ";
+            if (!ok)
+            {
+                std::cout << res.error << "\n";
+                failed++;
+                continue;
+            }
+            if (encode)
+                std::cout << std::fixed << std::setprecision(2) << 100.0 * res.outBytes / std::max<uint64_t>(res.inBytes, 1) << "%";
+            else
+                std::cout << "ok";
+            std::cout << " (" << std::fixed << std::setprecision(2) << res.seconds << " s)\n";
+            total.inBytes += res.inBytes;
+            total.outBytes += res.outBytes;
+            total.pcmBytes += res.pcmBytes;
+            total.stats.Merge(res.stats);
+            if (total.stages.empty())
+                total.stages = res.stages;
+            else
+                for (size_t s = 0; s < total.stages.size() && s < res.stages.size(); s++)
+                    total.stages[s].second += res.stages[s].second;
+        }
+    };
+    std::vector<std::thread> drivers;
+    for (size_t j = 0; j < std::min(jobs, inputs.size()); j++)
+        drivers.emplace_back(drive);
+    for (auto &t : drivers)
+        t.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "[Batch] " << inputs.size() - failed << "/" << inputs.size() << " files, "
+              << std::fixed << std::setprecision(1) << total.inBytes / 1e6 << " MB -> " << total.outBytes / 1e6 << " MB";
+    if (encode && total.inBytes > 0)
+        std::cout << " (" << std::setprecision(2) << 100.0 * total.outBytes / total.inBytes << "%)";
+    std::cout << " in " << std::setprecision(1) << seconds << " s";
+    if (seconds > 0)
+        std::cout << ", " << total.pcmBytes / seconds / 1e6 << " MB/s audio";
+    std::cout << "\n";
+    // Stage times are summed over the files; 'wall' is the whole batch's
+    if (opts.stats != StatsMode::Off && !total.stages.empty())
+    {
+        total.stages.back().second = seconds;
+        PrintStats(std::cout, opts.stats, encode ? "encode" : "decode", total.stats, total.stages);
+    }
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    // Options may appear anywhere; the rest are positional
+    std::vector<std::string> args;
+    EncodeOptions opts;
+    size_t jobs = 2; // Batch files in flight; chunk work shares the one pool
+    for (int i = 1; i < argc; i++)
+    {
+        std::string a = argv[i];
+        if (a == "--fast")
+            opts.level = VeloxCodec::Level::Fast;
+        else if (a == "--default")
+            opts.level = VeloxCodec::Level::Default;
+        else if (a == "--max")
+            opts.level = VeloxCodec::Level::Max;
+        else if (a == "--jobs" && i + 1 < argc)
+            jobs = (size_t)std::max(1, atoi(argv[++i]));
+        else if (a == "--stats")
+            opts.stats = StatsMode::Text;
+        else if (a == "--stats=json")
+            opts.stats = StatsMode::Json;
+        else
+            args.push_back(a);
+    }
+
+    // With the output on stdout, progress goes to stderr
+    bool pipeOut = (args.size() >= 3 && args[2] == "-");
+    std::ostream &console = pipeOut ? std::cerr : std::cout;
+    console << "=== VELOX CODEC v1.1 (Universal) ===\n";
+
+    if (args.size() < 3 || (args[0] != "-c" && args[0] != "-d"))
+    {
+        std::cout << "Usage:\n";
+        std::cout << "  Encode: velox -c [--fast|--default|--max] [--stats[=json]] input.wav/aif output.vlx [Artist] [Title]\n";
+        std::cout << "  Decode: velox -d [--stats[=json]] input.vlx output.wav\n";
+        std::cout << "  Batch:  velox -c|-d [--jobs N] [level] [--stats[=json]] input_dir/ output_dir/\n";
+        std::cout << "          --jobs: files in flight at once (default 2), all sharing one encode/decode pool\n";
+        std::cout << "  Pipes:  '-' as input or output reads stdin or writes stdout\n";
+        return 1;
+    }
+
+    std::string mode = args[0];
+    std::string inF = args[1];
+    std::string outF = args[2];
+    bool encode = (mode == "-c");
+#ifdef _WIN32
+    if (inF == "-")
+        _setmode(_fileno(stdin), _O_BINARY);
+    if (pipeOut)
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    // stdin is read and stdout written from different threads
+    std::cin.tie(nullptr);
+
+    std::error_code ec;
+    if (std::filesystem::is_directory(inF, ec))
+        return RunBatch(encode, inF, outF, jobs, opts);
+
+    if (encode)
+    {
+        if (args.size() > 3)
+            opts.artist = args[3];
+        if (args.size() > 4)
+            opts.title = args[4];
+    }
+    FileResult res;
+    bool ok = encode ? EncodeFile(inF, outF, opts, console, res) : DecodeFile(inF, outF, console, res, opts.stats);
+    if (!ok)
+    {
+        std::cerr << res.error << "\n";
+        return 1;
     }
     return 0;
-}
\ No newline at end of file
+}
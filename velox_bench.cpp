@@ -0,0 +1,1030 @@
+// Velox micro-benchmarks.
+// Times the residual (Rice) coder, the LPC kernels and the neural predictor
+// against references that match the original implementations, so before/after
+// numbers (and bit-exactness checks) come from one run. Then encodes and
+// decodes a generated corpus with the whole codec.
+//
+// Usage: velox_bench [--json] [--fast|--default|--max] [--codec-only]
+// --json prints one JSON document instead of the text report, so runs can be
+// saved and compared.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "VeloxEntropy.h"
+#include "VeloxCore.h"
+#include "VeloxSIMD.h"
+
+// --- ALLOCATIONS ---
+// Every heap allocation of the process goes through these, so a benchmark
+// can count the ones a codec call makes. Kept out of line: inlined into
+// callers, GCC takes the free() for a mismatched delete.
+static std::atomic<uint64_t> heapAllocs{0};
+
+#if defined(__GNUC__)
+#define VELOX_BENCH_NOINLINE __attribute__((noinline))
+#else
+#define VELOX_BENCH_NOINLINE
+#endif
+
+VELOX_BENCH_NOINLINE void *operator new(size_t size)
+{
+    heapAllocs.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+VELOX_BENCH_NOINLINE void operator delete(void *p) noexcept { free(p); }
+VELOX_BENCH_NOINLINE void operator delete(void *p, size_t) noexcept { free(p); }
+
+namespace {
+
+// --- REPORT ---
+// Each benchmark prints text lines and adds one record of named values
+struct Record
+{
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> values; // JSON-encoded
+};
+
+std::vector<Record> records;
+bool jsonOutput = false;
+
+void Text(const char *fmt, ...)
+{
+    if (jsonOutput)
+        return;
+    va_list args;
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+void Begin(const std::string &name) { records.push_back({name, {}}); }
+
+void Value(const char *key, double v)
+{
+    char buf[32] = "null";
+    if (std::isfinite(v))
+        snprintf(buf, sizeof(buf), "%.6g", v);
+    records.back().values.push_back({key, buf});
+}
+
+void Value(const char *key, uint64_t v) { records.back().values.push_back({key, std::to_string(v)}); }
+void Value(const char *key, bool v) { records.back().values.push_back({key, v ? "true" : "false"}); }
+
+// Peak resident set of the whole process so far, in KB
+uint64_t PeakRssKB()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return pmc.PeakWorkingSetSize / 1024;
+    return 0;
+#else
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+    return (uint64_t)ru.ru_maxrss / 1024; // Bytes on macOS
+#else
+    return (uint64_t)ru.ru_maxrss;
+#endif
+#endif
+}
+
+void PrintJson(const char *level)
+{
+    printf("{\n  \"version\": %d,\n  \"threads\": %zu,\n  \"level\": \"%s\",\n  \"lpc_kernel\": \"%s\",\n",
+           VELOX_VERSION, VeloxCodec::GetPool().Size(), level, LPCKernels::Get().name);
+    printf("  \"peak_rss_kb\": %llu,\n  \"results\": [", (unsigned long long)PeakRssKB());
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        printf("%s\n    {\"name\": \"%s\"", i ? "," : "", records[i].name.c_str());
+        for (const auto &v : records[i].values)
+            printf(", \"%s\": %s", v.first.c_str(), v.second.c_str());
+        printf("}");
+    }
+    printf("\n  ]\n}\n");
+}
+
+// --- REFERENCE: per-bit coder (pre word-at-a-time) ---
+class RefBitWriter
+{
+    std::vector<uint8_t> buffer;
+    uint64_t bit_acc = 0;
+    int bit_cnt = 0;
+
+public:
+    RefBitWriter() { buffer.reserve(4 * 1024 * 1024); }
+    void WriteBit(int bit)
+    {
+        if (bit)
+            bit_acc |= (1ULL << bit_cnt);
+        if (++bit_cnt == 8)
+        {
+            buffer.push_back((uint8_t)bit_acc);
+            bit_acc = 0;
+            bit_cnt = 0;
+        }
+    }
+    void Write(uint64_t val, int n)
+    {
+        for (int i = 0; i < n; i++)
+            WriteBit((val >> i) & 1);
+    }
+    void Flush()
+    {
+        if (bit_cnt > 0)
+            buffer.push_back((uint8_t)bit_acc);
+    }
+    const std::vector<uint8_t> &GetData() const { return buffer; }
+};
+
+class RefBitReader
+{
+    const uint8_t *data;
+    size_t size;
+    size_t pos = 0;
+    uint64_t bit_acc = 0;
+    int bit_cnt = 0;
+
+public:
+    RefBitReader(const uint8_t *d, size_t s) : data(d), size(s) {}
+    int ReadBit()
+    {
+        if (bit_cnt == 0)
+        {
+            if (pos >= size)
+                return 0;
+            bit_acc = data[pos++];
+            bit_cnt = 8;
+        }
+        int val = bit_acc & 1;
+        bit_acc >>= 1;
+        bit_cnt--;
+        return val;
+    }
+    uint64_t Read(int n)
+    {
+        uint64_t val = 0;
+        for (int i = 0; i < n; i++)
+            if (ReadBit())
+                val |= (1ULL << i);
+        return val;
+    }
+};
+
+void RefEncodeSample(RefBitWriter &bs, int64_t val, int k)
+{
+    uint64_t m = VeloxEntropy::ZigZag(val);
+    uint64_t q = m >> k;
+    uint64_t r = m & ((1ULL << k) - 1);
+    if (q < 64)
+    {
+        for (uint64_t i = 0; i < q; i++)
+            bs.WriteBit(1);
+        bs.WriteBit(0);
+        if (k > 0)
+            bs.Write(r, k);
+    }
+    else
+    {
+        for (uint64_t i = 0; i < 64; i++)
+            bs.WriteBit(1);
+        bs.WriteBit(0);
+        bs.Write(m, 40);
+    }
+}
+
+int64_t RefDecodeSample(RefBitReader &bs, int k)
+{
+    uint64_t q = 0;
+    while (bs.ReadBit())
+        q++;
+    uint64_t m = (q < 64) ? ((q << k) | ((k > 0) ? bs.Read(k) : 0)) : bs.Read(40);
+    return VeloxEntropy::DeZigZag(m);
+}
+
+// Same adaptive-k rule as the channel workers in VeloxCore.h
+inline int NextK(uint64_t &run_avg, int64_t res)
+{
+    uint64_t m = VeloxEntropy::ZigZag(res);
+    run_avg = run_avg - (run_avg >> 3) + (m >> 3);
+    if (run_avg < 1)
+        run_avg = 1;
+    return 63 - __builtin_clzll(run_avg);
+}
+
+template <class Writer, class EncFn>
+std::vector<uint8_t> EncodeAll(const std::vector<int64_t> &res, EncFn enc)
+{
+    Writer bs;
+    uint64_t run_avg = 512;
+    int k = 9;
+    for (int64_t r : res)
+    {
+        enc(bs, r, k);
+        k = NextK(run_avg, r);
+    }
+    bs.Flush();
+    return bs.GetData();
+}
+
+template <class Reader, class DecFn>
+bool DecodeAll(const std::vector<uint8_t> &data, const std::vector<int64_t> &res, DecFn dec)
+{
+    Reader bs(data.data(), data.size());
+    uint64_t run_avg = 512;
+    int k = 9;
+    bool ok = true;
+    for (int64_t r : res)
+    {
+        int64_t v = dec(bs, k);
+        ok &= (v == r);
+        k = NextK(run_avg, v);
+    }
+    return ok;
+}
+
+template <class Fn>
+double TimeBest(Fn fn, int reps = 5)
+{
+    double best = 1e30;
+    for (int i = 0; i < reps; i++)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        fn();
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+    }
+    return best;
+}
+
+// Two ways of doing the same work timed in alternating single runs, so
+// drift and noise hit both alike. Times are medians; the speedup is the
+// median of the per-run ratios tA/tB, with its lowest and highest value.
+struct Alternation
+{
+    double tA, tB;
+    double speedup, low, high;
+};
+
+template <class FnA, class FnB>
+Alternation TimeAlternating(FnA a, FnB b, int runs = 11)
+{
+    auto time = [](auto &fn)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    };
+    auto median = [](std::vector<double> v)
+    {
+        std::sort(v.begin(), v.end());
+        return v[v.size() / 2];
+    };
+    a();
+    b(); // Warm-up
+    std::vector<double> tA, tB, ratio;
+    for (int i = 0; i < runs; i++)
+    {
+        tA.push_back(time(a));
+        tB.push_back(time(b));
+        ratio.push_back(tA.back() / tB.back());
+    }
+    return {median(tA), median(tB), median(ratio), *std::min_element(ratio.begin(), ratio.end()),
+            *std::max_element(ratio.begin(), ratio.end())};
+}
+
+// Laplacian-like residuals with slowly varying scale and rare escapes
+std::vector<int64_t> MakeResiduals(size_t n, double scale)
+{
+    std::mt19937_64 rng(42);
+    std::exponential_distribution<double> expo(1.0);
+    std::vector<int64_t> res(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        double s = scale * (1.0 + 0.5 * std::sin((double)i * 1e-4));
+        int64_t v = (int64_t)(expo(rng) * s);
+        if ((rng() & 1023) == 0)
+            v *= 4096;
+        res[i] = (rng() & 1) ? v : -v;
+    }
+    return res;
+}
+
+void BenchRice(const char *label, double scale)
+{
+    const size_t N = 4 * 1024 * 1024;
+    std::vector<int64_t> res = MakeResiduals(N, scale);
+
+    auto encNew = [](BitStreamWriter &bs, int64_t v, int k) { VeloxEntropy::EncodeSample(bs, v, k); };
+    auto decNew = [](BitStreamReader &bs, int k) { return VeloxEntropy::DecodeSample(bs, k); };
+
+    std::vector<uint8_t> refData, newData;
+    double tEncRef = TimeBest([&] { refData = EncodeAll<RefBitWriter>(res, RefEncodeSample); });
+    double tEncNew = TimeBest([&] { newData = EncodeAll<BitStreamWriter>(res, encNew); });
+    bool same = (refData == newData);
+
+    bool okRef = true, okNew = true;
+    double tDecRef = TimeBest([&] { okRef = DecodeAll<RefBitReader>(refData, res, RefDecodeSample); });
+    double tDecNew = TimeBest([&] { okNew = DecodeAll<BitStreamReader>(newData, res, decNew); });
+
+    Text("rice/%-8s %6.2f bits/sample  identical=%s  roundtrip=%s\n", label,
+         8.0 * newData.size() / N, same ? "yes" : "NO", (okRef && okNew) ? "yes" : "NO");
+    Text("  encode  before %8.1f Msamples/s   after %8.1f Msamples/s   (x%.2f)\n",
+         N / tEncRef / 1e6, N / tEncNew / 1e6, tEncRef / tEncNew);
+    Text("  decode  before %8.1f Msamples/s   after %8.1f Msamples/s   (x%.2f)\n",
+         N / tDecRef / 1e6, N / tDecNew / 1e6, tDecRef / tDecNew);
+
+    Begin(std::string("rice/") + label);
+    Value("bits_per_sample", 8.0 * newData.size() / N);
+    Value("encode_msamples_s", N / tEncNew / 1e6);
+    Value("decode_msamples_s", N / tDecNew / 1e6);
+    Value("ref_encode_msamples_s", N / tEncRef / 1e6);
+    Value("ref_decode_msamples_s", N / tDecRef / 1e6);
+    Value("identical", same && okRef && okNew);
+}
+
+// --- LPC: original per-tap bounds-checked loop vs. LPCKernels ---
+std::vector<velox_sample_t> MakeSignal(size_t n)
+{
+    std::mt19937_64 rng(7);
+    std::normal_distribution<double> noise(0.0, 200.0);
+    std::vector<velox_sample_t> x(n);
+    for (size_t i = 0; i < n; i++)
+        x[i] = (velox_sample_t)(6000000.0 * std::sin((double)i * 0.013) + 900000.0 * std::sin((double)i * 0.171) +
+                                noise(rng));
+    return x;
+}
+
+void BenchLPC()
+{
+    const size_t N = 4 * 1024 * 1024;
+    const int order = 8;
+    const int coeffs[order] = {3412, -1893, 611, 204, -377, 158, -61, 22};
+    std::vector<velox_sample_t> x = MakeSignal(N);
+    std::vector<int32_t> x32(x.begin(), x.end());
+
+    std::vector<int64_t> ref(N), sums(N);
+    double tRef = TimeBest([&] {
+        for (size_t b = 0; b < N; b += 4096)
+            for (size_t i = 0; i < 4096; i++)
+            {
+                int64_t sum = 0;
+                for (int j = 0; j < order; j++)
+                    if (i > (size_t)j)
+                        sum += (int64_t)coeffs[j] * x[b + i - 1 - j];
+                ref[b + i] = sum;
+            }
+    });
+
+    std::vector<LPCKernels::Table> tables = {LPCKernels::Scalar()};
+#if VELOX_SIMD_X86
+    if (__builtin_cpu_supports("sse4.1"))
+        tables.push_back(LPCKernels::SSE41());
+    if (__builtin_cpu_supports("avx2"))
+        tables.push_back(LPCKernels::AVX2());
+#endif
+
+    Text("lpc/residual  order %d  (runtime pick: %s)\n", order, LPCKernels::Get().name);
+    Text("  %-8s %8.1f Msamples/s\n", "before", N / tRef / 1e6);
+    Begin("lpc/reference");
+    Value("msamples_s", N / tRef / 1e6);
+    for (const auto &t : tables)
+    {
+        // Chunk-sized blocks, as the encoder calls it
+        double tk = TimeBest([&] {
+            for (size_t b = 0; b < N; b += 4096)
+                t.sums(x.data() + b, 4096, coeffs, order, sums.data() + b);
+        });
+        Text("  %-8s %8.1f Msamples/s   (x%.2f)  identical=%s\n", t.name, N / tk / 1e6, tRef / tk,
+             (sums == ref) ? "yes" : "NO");
+        Begin(std::string("lpc/") + t.name);
+        Value("msamples_s", N / tk / 1e6);
+        Value("identical", sums == ref);
+
+        // Same sums over the encoder's 32-bit working buffers
+        std::fill(sums.begin(), sums.end(), 0);
+        double tk32 = TimeBest([&] {
+            for (size_t b = 0; b < N; b += 4096)
+                t.sums32(x32.data() + b, 4096, coeffs, order, sums.data() + b);
+        });
+        std::string name32 = std::string(t.name) + "/32";
+        Text("  %-8s %8.1f Msamples/s   (x%.2f)  identical=%s\n", name32.c_str(), N / tk32 / 1e6, tRef / tk32,
+             (sums == ref) ? "yes" : "NO");
+        Begin("lpc/" + name32);
+        Value("msamples_s", N / tk32 / 1e6);
+        Value("identical", sums == ref);
+    }
+}
+
+// --- NEURAL: original branchy/shifting predictor vs. NeuralPredictor ---
+class RefNeuralPredictor
+{
+    static const int ORDER = 12;
+    int32_t weights[ORDER] = {0};
+    int32_t history[ORDER] = {0};
+
+public:
+    int32_t Predict()
+    {
+        int64_t sum = 0;
+        for (int i = 0; i < ORDER; i++)
+            sum += (int64_t)history[i] * weights[i];
+        return (int32_t)(sum >> 11);
+    }
+    void Update(int32_t actual, int32_t pred)
+    {
+        int32_t err = actual - pred;
+        int sign = (err > 0) ? 1 : ((err < 0) ? -1 : 0);
+        if (sign == 0)
+            return;
+        int delta = (std::abs(err) > 1024) ? 16 : 4;
+        for (int i = 0; i < ORDER; i++)
+        {
+            int h_sign = (history[i] > 0) ? 1 : ((history[i] < 0) ? -1 : 0);
+            if (sign == h_sign)
+                weights[i] += delta;
+            else if (h_sign != 0)
+                weights[i] -= delta;
+            if ((i & 7) == 0)
+            {
+                if (weights[i] > 0)
+                    weights[i]--;
+                if (weights[i] < 0)
+                    weights[i]++;
+            }
+        }
+        for (int i = ORDER - 1; i > 0; i--)
+            history[i] = history[i - 1];
+        history[0] = actual;
+    }
+};
+
+template <class Predictor>
+int64_t RunPredictor(const std::vector<int32_t> &signal, std::vector<int32_t> *preds)
+{
+    Predictor p;
+    int64_t check = 0;
+    for (size_t i = 0; i < signal.size(); i++)
+    {
+        int32_t pred = p.Predict();
+        if (preds)
+            (*preds)[i] = pred;
+        check += pred;
+        p.Update(signal[i], pred);
+    }
+    return check;
+}
+
+// Synthetic LPC-residual corpus: tonal, noisy, silent, bursty and full-scale
+std::vector<std::pair<const char *, std::vector<int32_t>>> MakeNeuralCorpus(size_t n)
+{
+    std::mt19937_64 rng(99);
+    std::normal_distribution<double> gauss(0.0, 1.0);
+    std::vector<std::pair<const char *, std::vector<int32_t>>> corpus;
+    std::vector<int32_t> v(n);
+
+    for (size_t i = 0; i < n; i++)
+        v[i] = (int32_t)(400.0 * std::sin((double)i * 0.05) + 40.0 * gauss(rng));
+    corpus.push_back({"tonal", v});
+    for (size_t i = 0; i < n; i++)
+        v[i] = (int32_t)(3000.0 * gauss(rng));
+    corpus.push_back({"noise", v});
+    for (size_t i = 0; i < n; i++)
+        v[i] = ((i / 5000) & 1) ? (int32_t)(2.0 * gauss(rng)) : 0;
+    corpus.push_back({"sparse", v});
+    for (size_t i = 0; i < n; i++)
+        v[i] = ((rng() & 255) == 0) ? (int32_t)(rng() % 16777216) - 8388608 : (int32_t)(8.0 * gauss(rng));
+    corpus.push_back({"bursts", v});
+    for (size_t i = 0; i < n; i++)
+        v[i] = (i & 1) ? 8388607 : -8388608;
+    corpus.push_back({"fullscale", v});
+    return corpus;
+}
+
+void BenchNeural()
+{
+    const size_t N = 2 * 1024 * 1024;
+    auto corpus = MakeNeuralCorpus(N);
+    Text("neural/predictor  (conformance vs. original)\n");
+    for (const auto &entry : corpus)
+    {
+        const std::vector<int32_t> &sig = entry.second;
+        std::vector<int32_t> refPreds(N), newPreds(N);
+        RunPredictor<RefNeuralPredictor>(sig, &refPreds);
+        RunPredictor<NeuralPredictor>(sig, &newPreds);
+
+        volatile int64_t sink = 0;
+        double tRef = TimeBest([&] { sink = sink + RunPredictor<RefNeuralPredictor>(sig, nullptr); });
+        double tNew = TimeBest([&] { sink = sink + RunPredictor<NeuralPredictor>(sig, nullptr); });
+        Text("  %-9s before %7.1f Msamples/s   after %7.1f Msamples/s   (x%.2f)  identical=%s\n", entry.first,
+             N / tRef / 1e6, N / tNew / 1e6, tRef / tNew, (refPreds == newPreds) ? "yes" : "NO");
+        Begin(std::string("neural/") + entry.first);
+        Value("msamples_s", N / tNew / 1e6);
+        Value("ref_msamples_s", N / tRef / 1e6);
+        Value("identical", refPreds == newPreds);
+    }
+}
+
+// --- CORPUS ---
+// Deterministic test signals as WAV data chunk bytes (little endian,
+// interleaved), so every run and every machine encodes the same input
+struct CorpusCase
+{
+    std::string name;
+    uint16_t channels;
+    uint16_t bits;
+    bool isFloat;
+    std::vector<uint8_t> pcm;
+};
+
+const double TWO_PI = 6.283185307179586;
+
+enum class Signal { Sweep, White, Pink, Silence, Tones };
+enum class Sample { Int, Float, PseudoFloat }; // PseudoFloat: floats holding exact 'bits'-bit integers
+
+// Per-channel signal in [-1, 1]; channels differ slightly so stereo
+// decorrelation has something to do
+std::vector<double> MakeWave(Signal sig, size_t frames, uint16_t channels, uint64_t seed)
+{
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> uni(-1.0, 1.0);
+    std::vector<double> x(frames * channels, 0.0);
+    const double rate = 44100.0;
+    for (uint16_t ch = 0; ch < channels; ch++)
+    {
+        double phase = 0.0;
+        double b0 = 0, b1 = 0, b2 = 0; // Pink noise filter state
+        for (size_t i = 0; i < frames; i++)
+        {
+            double t = (double)i / rate;
+            double v = 0.0;
+            switch (sig)
+            {
+            case Signal::Sweep:
+                // Exponential sweep 20 Hz .. 20 kHz over the whole signal
+                phase += TWO_PI * 20.0 * std::pow(1000.0, (double)i / frames) / rate;
+                v = 0.8 * std::sin(phase + 0.3 * ch);
+                break;
+            case Signal::White:
+                v = 0.5 * uni(rng);
+                break;
+            case Signal::Pink:
+            {
+                double w = uni(rng);
+                b0 = 0.99765 * b0 + w * 0.0990460;
+                b1 = 0.96300 * b1 + w * 0.2965164;
+                b2 = 0.57000 * b2 + w * 1.0526913;
+                v = 0.15 * (b0 + b1 + b2 + w * 0.1848);
+                break;
+            }
+            case Signal::Silence:
+                break;
+            case Signal::Tones:
+            {
+                double env = 0.5 + 0.5 * std::sin(TWO_PI * 0.25 * t);
+                v = env * (0.4 * std::sin(TWO_PI * 220.0 * t + ch) + 0.2 * std::sin(TWO_PI * 661.0 * t) +
+                           0.1 * std::sin(TWO_PI * 1327.0 * t)) +
+                    0.01 * uni(rng);
+                break;
+            }
+            }
+            x[i * channels + ch] = std::max(-1.0, std::min(1.0, v));
+        }
+    }
+    return x;
+}
+
+struct CaseSpec
+{
+    const char *name;
+    Signal sig;
+    Sample kind;
+    uint16_t bits; // Integer precision (pseudo-floats are stored as 32-bit floats)
+    uint16_t channels;
+    size_t frames;
+};
+
+const size_t CORPUS_FRAMES = 1 << 19; // ~12 s at 44.1 kHz
+
+const CaseSpec CORPUS[] = {
+    {"sweep16_stereo", Signal::Sweep, Sample::Int, 16, 2, CORPUS_FRAMES},
+    {"sweep24_mono", Signal::Sweep, Sample::Int, 24, 1, CORPUS_FRAMES},
+    {"white16_stereo", Signal::White, Sample::Int, 16, 2, CORPUS_FRAMES},
+    {"pink24_stereo", Signal::Pink, Sample::Int, 24, 2, CORPUS_FRAMES},
+    {"silence16_stereo", Signal::Silence, Sample::Int, 16, 2, CORPUS_FRAMES},
+    {"tones_float32_stereo", Signal::Tones, Sample::Float, 24, 2, CORPUS_FRAMES},
+    {"pseudofloat16_stereo", Signal::Tones, Sample::PseudoFloat, 16, 2, CORPUS_FRAMES},
+    {"pseudofloat24_mono", Signal::Pink, Sample::PseudoFloat, 24, 1, CORPUS_FRAMES},
+    // Odd lengths: a final partial chunk, and loose samples past the last frame
+    {"odd_tones16_mono", Signal::Tones, Sample::Int, 16, 1, CORPUS_FRAMES + 777},
+    {"odd_pink24_stereo", Signal::Pink, Sample::Int, 24, 2, CORPUS_FRAMES / 2 + 1},
+};
+
+// Cases are generated one at a time, so the peak RSS follows the codec
+// rather than the corpus
+CorpusCase MakeCase(const CaseSpec &spec, uint64_t seed)
+{
+    Sample kind = spec.kind;
+    uint16_t bits = spec.bits;
+    CorpusCase c = {spec.name, spec.channels, (uint16_t)(kind == Sample::Int ? bits : 32), kind != Sample::Int, {}};
+    std::vector<double> x = MakeWave(spec.sig, spec.frames, spec.channels, seed);
+    double full = (double)((1 << (bits - 1)) - 1);
+    c.pcm.resize(x.size() * (c.bits / 8));
+    uint8_t *out = c.pcm.data();
+    for (double v : x)
+    {
+        if (kind == Sample::Float)
+        {
+            float f = (float)v;
+            memcpy(out, &f, 4);
+            out += 4;
+            continue;
+        }
+        int32_t q = (int32_t)std::lround(v * full);
+        if (kind == Sample::PseudoFloat)
+        {
+            float f = (float)q / (float)(1 << (bits - 1));
+            memcpy(out, &f, 4);
+            out += 4;
+            continue;
+        }
+        for (int b = 0; b < bits / 8; b++)
+            *out++ = (uint8_t)(q >> (8 * b));
+    }
+    return c;
+}
+
+// --- CODEC ---
+// Whole-file encode (Encoder::ProcessBlock) and decode (StreamingDecoder,
+// with the decode-ahead the CLI uses). MB/s counts PCM bytes of the input.
+// The round trip is checked by converting the decoded samples back to PCM
+// bytes the way velox -d does. Integer sources of up to 24 bits are also
+// encoded from and decoded into 32-bit samples, which is what velox -c and
+// velox -d use for them.
+bool BenchCodec(const CorpusCase &c, VeloxCodec::Level level)
+{
+    size_t sampleBytes = c.bits / 8;
+    size_t count = c.pcm.size() / sampleBytes;
+    std::vector<velox_sample_t> samples;
+    std::vector<uint8_t> exps;
+    if (c.isFloat)
+        FormatHandler::SplitFloat32(c.pcm.data(), count, samples, exps);
+    else
+        FormatHandler::BytesToSamples(c.pcm.data(), count, c.bits, samples);
+
+    // ProcessBlock demotes pseudo-float input in place, so each run gets a
+    // fresh copy outside the timed region
+    VeloxCodec::Encoder encoder(level);
+    std::vector<uint8_t> payload;
+    double tEnc = 1e30;
+    for (int rep = 0; rep < 3; rep++)
+    {
+        std::vector<velox_sample_t> work = samples;
+        payload = std::vector<uint8_t>();
+        auto t0 = std::chrono::steady_clock::now();
+        payload = encoder.ProcessBlock(work, c.isFloat, exps, c.pcm.data(), c.channels);
+        auto t1 = std::chrono::steady_clock::now();
+        tEnc = std::min(tEnc, std::chrono::duration<double>(t1 - t0).count());
+    }
+    size_t chunks = std::max<size_t>(encoder.GetSeekTable().size(), 1);
+
+    // Steady-state EncodeAll() allocations: one stream encoder codes the
+    // input three times over into a sink and seek table with room reserved,
+    // and only the last pass is counted, once pool buffers, per-thread scratch and the
+    // encoder's span slots have warmed up. Expected to be zero.
+    auto encodeAllocs = [&](VeloxCodec::Level lvl)
+    {
+        std::vector<uint8_t> sunk;
+        sunk.reserve(4 * c.pcm.size() + 4096);
+        VeloxCodec::StreamEncoder stream([&sunk](const uint8_t *data, size_t size)
+                                         { sunk.insert(sunk.end(), data, data + size); },
+                                         c.channels, c.isFloat, 0, lvl);
+        stream.ReserveSeekTable(4 * count);
+        uint64_t allocs = 0;
+        for (int pass = 0; pass < 3; pass++)
+        {
+            uint64_t a0 = heapAllocs.load();
+            stream.EncodeAll(samples.data(), c.isFloat ? exps.data() : nullptr, count);
+            allocs = heapAllocs.load() - a0;
+        }
+        return allocs;
+    };
+    uint64_t encAllocs = encodeAllocs(level);
+
+    // The 32-bit pipeline against the 64-bit one, in alternating runs: a
+    // best-of-few taken one after the other mostly measures which went first
+    bool narrow = !c.isFloat && c.bits <= 24;
+    Alternation enc32 = {};
+    bool identical32 = true;
+    if (narrow)
+    {
+        std::vector<int32_t> samples32;
+        FormatHandler::BytesToSamples(c.pcm.data(), count, c.bits, samples32);
+        std::vector<uint8_t> payload64, payload32;
+        // Integer input is not demoted, so 'samples' can be encoded as is
+        enc32 = TimeAlternating([&] { payload64 = encoder.ProcessBlock(samples, false, exps, nullptr, c.channels); },
+                                [&] { payload32 = encoder.ProcessBlock(samples32, c.channels); });
+        identical32 = (payload32 == payload);
+    }
+
+    // The Push() path velox -c takes: slices that do not line up with
+    // chunks, into a sink with room reserved. The encoder is built outside
+    // the count, and its span slots fill on first use, so a run makes a
+    // fixed few allocations whatever its length. Float input keeps its
+    // exponents here (no demotion), so only integer output is compared.
+    bool pushIdentical = true;
+    auto pushAllocs = [&](VeloxCodec::Level lvl, size_t &pushChunks)
+    {
+        std::vector<uint8_t> sunk;
+        sunk.reserve(2 * c.pcm.size() + 4096);
+        VeloxCodec::StreamEncoder stream([&sunk](const uint8_t *data, size_t size)
+                                         { sunk.insert(sunk.end(), data, data + size); },
+                                         c.channels, c.isFloat, 0, lvl);
+        const size_t slice = 65537;
+        uint64_t a0 = heapAllocs.load();
+        for (size_t i = 0; i < count; i += slice)
+            stream.Push(samples.data() + i, c.isFloat ? exps.data() + i : nullptr, std::min(slice, count - i));
+        stream.Close();
+        uint64_t allocs = heapAllocs.load() - a0;
+        pushChunks = std::max<size_t>(stream.GetSeekTable().size(), 1);
+        if (!c.isFloat && lvl == level)
+            pushIdentical = (sunk == payload);
+        return allocs;
+    };
+    size_t pushChunks = 0;
+    pushAllocs(level, pushChunks); // Warms per-thread scratch for this path
+    uint64_t pushAllocCount = pushAllocs(level, pushChunks);
+
+    // Max level allocations whatever level is benched, through both paths
+    uint64_t maxAllocs = encAllocs, maxPushAllocs = pushAllocCount;
+    size_t maxChunks = chunks, maxPushChunks = pushChunks;
+    if (level != VeloxCodec::Level::Max)
+    {
+        maxAllocs = encodeAllocs(VeloxCodec::Level::Max);
+        pushAllocs(VeloxCodec::Level::Max, maxPushChunks);
+        maxPushAllocs = pushAllocs(VeloxCodec::Level::Max, maxPushChunks);
+        maxChunks = maxPushChunks;
+    }
+    bool encodeSteady = encAllocs == 0 && maxAllocs == 0;
+
+    size_t ahead = 2 * VeloxCodec::GetPool().Size();
+    std::vector<velox_sample_t> decoded;
+    std::vector<uint8_t> decodedExps;
+    int floatMode = 0;
+    bool streamFloat = false;
+    // Decodes into 'into' (if 'keep'), with its element type as the sample type
+    auto decodeAll = [&](auto &into, bool keep)
+    {
+        typedef typename std::decay_t<decltype(into)>::value_type SampleType;
+        VeloxCodec::BasicStreamingDecoder<SampleType> dec(payload.data(), payload.size(), count, VELOX_VERSION,
+                                                          c.channels);
+        dec.SetDecodeAhead(ahead);
+        size_t cap = dec.MaxChunkSamples() * 4;
+        std::vector<SampleType> out(cap);
+        std::vector<uint8_t> outExps(cap);
+        size_t n;
+        while ((n = dec.DecodeFrames(out.data(), outExps.data(), cap)) > 0)
+        {
+            if (!keep)
+                continue;
+            into.insert(into.end(), out.begin(), out.begin() + n);
+            decodedExps.insert(decodedExps.end(), outExps.begin(), outExps.begin() + n);
+        }
+        floatMode = dec.GetFloatMode();
+        streamFloat = dec.IsFloat();
+    };
+    double tDec = TimeBest([&] { decodeAll(decoded, false); }, 3);
+
+    // Steady-state decode allocations, serial and with decode-ahead: the
+    // first chunk sizes the decoder's scratch and slots, after which a
+    // decoder is expected to stay off the heap
+    auto decodeAllocs = [&](size_t depth)
+    {
+        VeloxCodec::StreamingDecoder dec(payload.data(), payload.size(), count, VELOX_VERSION, c.channels);
+        dec.SetDecodeAhead(depth);
+        std::vector<velox_sample_t> out(dec.MaxChunkSamples());
+        std::vector<uint8_t> outExps(out.size());
+        dec.DecodeFrames(out.data(), outExps.data(), out.size());
+        uint64_t a0 = heapAllocs.load();
+        while (dec.DecodeFrames(out.data(), outExps.data(), out.size()) > 0)
+        {
+        }
+        return heapAllocs.load() - a0;
+    };
+    uint64_t decAllocs = decodeAllocs(0);
+    uint64_t decAheadAllocs = decodeAllocs(ahead);
+    bool steady = decAllocs == 0 && decAheadAllocs == 0;
+
+    decodeAll(decoded, true);
+    std::vector<uint8_t> restored;
+    if (streamFloat)
+        FormatHandler::MergeFloat32(decoded, decodedExps, restored);
+    else if (c.isFloat)
+        FormatHandler::PromoteIntToFloat(decoded, floatMode == 1 ? 16 : 24, restored);
+    else
+        FormatHandler::SamplesToBytes(decoded, c.bits, restored);
+    bool roundtrip = (restored == c.pcm);
+
+    Alternation dec32 = {};
+    bool roundtrip32 = true;
+    if (narrow)
+    {
+        std::vector<int32_t> decoded32;
+        dec32 = TimeAlternating([&] { decodeAll(decoded, false); }, [&] { decodeAll(decoded32, false); });
+        decodeAll(decoded32, true);
+        std::vector<uint8_t> restored32;
+        FormatHandler::SamplesToBytes(decoded32, c.bits, restored32);
+        roundtrip32 = (restored32 == c.pcm);
+    }
+
+    double mb = c.pcm.size() / 1e6;
+    double ratio = 100.0 * payload.size() / c.pcm.size();
+    Text("  %-22s %6.2f%%  encode %7.1f MB/s %7.2f Msamples/s  decode %7.1f MB/s %7.2f Msamples/s  roundtrip=%s\n",
+         c.name.c_str(), ratio, mb / tEnc, count / tEnc / 1e6, mb / tDec, count / tDec / 1e6,
+         roundtrip ? "yes" : "NO");
+    Text("  %-22s encode allocations after warm-up %llu over %zu chunks, Push() %llu (%.2f per chunk)%s%s\n", "",
+         (unsigned long long)encAllocs, chunks, (unsigned long long)pushAllocCount, (double)pushAllocCount / pushChunks,
+         encAllocs == 0 ? "" : "  (expected 0)", pushIdentical ? "" : "  (Push() output DIFFERS)");
+    Text("  %-22s max level allocations after warm-up %llu over %zu chunks, Push() %llu (%.2f per chunk)%s\n", "",
+         (unsigned long long)maxAllocs, maxChunks, (unsigned long long)maxPushAllocs,
+         (double)maxPushAllocs / maxPushChunks, maxAllocs == 0 ? "" : "  (expected 0)");
+    if (narrow)
+        Text("  %-22s encode from 32-bit samples %7.1f MB/s %7.2f Msamples/s (x%.2f, x%.2f-x%.2f)  identical=%s\n",
+             "", mb / enc32.tB, count / enc32.tB / 1e6, enc32.speedup, enc32.low, enc32.high,
+             identical32 ? "yes" : "NO");
+    Text("  %-22s decode allocations after the first chunk: %llu serial, %llu decode-ahead%s\n", "",
+         (unsigned long long)decAllocs, (unsigned long long)decAheadAllocs, steady ? "" : "  (expected 0)");
+    if (narrow)
+        Text("  %-22s decode into 32-bit samples %7.1f MB/s %7.2f Msamples/s (x%.2f, x%.2f-x%.2f)  roundtrip=%s\n",
+             "", mb / dec32.tB, count / dec32.tB / 1e6, dec32.speedup, dec32.low, dec32.high,
+             roundtrip32 ? "yes" : "NO");
+
+    Begin("codec/" + c.name);
+    Value("channels", (uint64_t)c.channels);
+    Value("bits", (uint64_t)c.bits);
+    Value("float", c.isFloat);
+    Value("samples", (uint64_t)count);
+    Value("pcm_bytes", (uint64_t)c.pcm.size());
+    Value("encoded_bytes", (uint64_t)payload.size());
+    Value("ratio_percent", ratio);
+    Value("float_mode", (uint64_t)floatMode);
+    Value("encode_mb_s", mb / tEnc);
+    Value("encode_msamples_s", count / tEnc / 1e6);
+    if (narrow)
+    {
+        Value("encode32_mb_s", mb / enc32.tB);
+        Value("encode32_msamples_s", count / enc32.tB / 1e6);
+        Value("encode32_speedup_median", enc32.speedup);
+        Value("encode32_speedup_min", enc32.low);
+        Value("encode32_speedup_max", enc32.high);
+        Value("encode32_identical", identical32);
+    }
+    Value("encode_allocs", encAllocs);
+    Value("push_allocs", pushAllocCount);
+    Value("push_allocs_per_chunk", (double)pushAllocCount / pushChunks);
+    Value("push_identical", pushIdentical);
+    Value("max_encode_allocs", maxAllocs);
+    Value("max_push_allocs", maxPushAllocs);
+    Value("max_push_allocs_per_chunk", (double)maxPushAllocs / maxPushChunks);
+    Value("decode_mb_s", mb / tDec);
+    Value("decode_msamples_s", count / tDec / 1e6);
+    Value("decode_allocs", decAllocs);
+    Value("decode_ahead_allocs", decAheadAllocs);
+    if (narrow)
+    {
+        Value("decode32_mb_s", mb / dec32.tB);
+        Value("decode32_msamples_s", count / dec32.tB / 1e6);
+        Value("decode32_speedup_median", dec32.speedup);
+        Value("decode32_speedup_min", dec32.low);
+        Value("decode32_speedup_max", dec32.high);
+        Value("roundtrip32", roundtrip32);
+    }
+    Value("roundtrip", roundtrip);
+    Value("peak_rss_kb", PeakRssKB());
+    return roundtrip && roundtrip32 && identical32 && pushIdentical && encodeSteady && steady;
+}
+
+// Full-range 32-bit stereo through the int32_t encoder at every level. The
+// spans are chosen so mid and side leave 32 bits: near-equal channels at
+// the rails, opposite channels at the rails, then uniform noise. Spans like
+// these fall back to 64-bit working buffers, so the bytes must match the
+// 64-bit encode and decode back to the input.
+bool BenchFullRange32()
+{
+    const size_t frames = 3 * VeloxCodec::CHUNK_FRAMES + 5;
+    std::mt19937_64 rng(32);
+    std::vector<int32_t> samples32(2 * frames);
+    for (size_t i = 0; i < frames; i++)
+    {
+        int64_t a = (int64_t)(2147483000.0 * std::sin((double)i * 0.01));
+        int64_t jitter = (int64_t)(rng() % 512);
+        int64_t l, r;
+        if (i < VeloxCodec::CHUNK_FRAMES)
+            l = a, r = a - jitter;
+        else if (i < 2 * VeloxCodec::CHUNK_FRAMES)
+            l = a, r = -a + jitter;
+        else
+            l = (int32_t)rng(), r = (int32_t)rng();
+        if (i % 997 == 0)
+            l = INT32_MIN, r = INT32_MAX;
+        samples32[2 * i] = (int32_t)std::clamp<int64_t>(l, INT32_MIN, INT32_MAX);
+        samples32[2 * i + 1] = (int32_t)std::clamp<int64_t>(r, INT32_MIN, INT32_MAX);
+    }
+
+    bool ok = true;
+    const VeloxCodec::Level levels[] = {VeloxCodec::Level::Fast, VeloxCodec::Level::Default, VeloxCodec::Level::Max};
+    const char *names[] = {"fast", "default", "max"};
+    Begin("codec/fullrange32_stereo");
+    Text("codec/fullrange32_stereo  (32-bit stereo at +-2^31)\n");
+    for (int l = 0; l < 3; l++)
+    {
+        VeloxCodec::Encoder encoder(levels[l]);
+        std::vector<uint8_t> payload32 = encoder.ProcessBlock(samples32, 2);
+        std::vector<velox_sample_t> samples(samples32.begin(), samples32.end());
+        std::vector<uint8_t> payload = encoder.ProcessBlock(samples, false, {}, nullptr, 2);
+        bool identical = (payload32 == payload);
+
+        VeloxCodec::StreamingDecoder dec(payload32.data(), payload32.size(), samples.size(), VELOX_VERSION, 2);
+        std::vector<velox_sample_t> decoded(samples.size());
+        size_t n = 0, got;
+        while (n < decoded.size() && (got = dec.DecodeFrames(decoded.data() + n, nullptr, decoded.size() - n)) > 0)
+            n += got;
+        bool roundtrip = (n == samples.size()) && (decoded == samples);
+        Text("  %-8s identical=%s  roundtrip=%s\n", names[l], identical ? "yes" : "NO", roundtrip ? "yes" : "NO");
+        Value((std::string(names[l]) + "_identical").c_str(), identical);
+        Value((std::string(names[l]) + "_roundtrip").c_str(), roundtrip);
+        ok &= identical && roundtrip;
+    }
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    VeloxCodec::Level level = VeloxCodec::Level::Default;
+    const char *levelName = "default";
+    bool codecOnly = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0)
+            jsonOutput = true;
+        else if (strcmp(argv[i], "--codec-only") == 0)
+            codecOnly = true;
+        else if (strcmp(argv[i], "--fast") == 0)
+            level = VeloxCodec::Level::Fast, levelName = "fast";
+        else if (strcmp(argv[i], "--default") == 0)
+            level = VeloxCodec::Level::Default, levelName = "default";
+        else if (strcmp(argv[i], "--max") == 0)
+            level = VeloxCodec::Level::Max, levelName = "max";
+        else
+        {
+            fprintf(stderr, "Usage: velox_bench [--json] [--fast|--default|--max] [--codec-only]\n");
+            return 1;
+        }
+    }
+
+    Text("=== VELOX BENCH ===\n");
+    if (!codecOnly)
+    {
+        BenchRice("quiet", 8.0);
+        BenchRice("music", 300.0);
+        BenchRice("loud", 20000.0);
+        BenchLPC();
+        BenchNeural();
+    }
+
+    Text("codec/corpus  (level %s, %zu pool threads)\n", levelName, VeloxCodec::GetPool().Size());
+    bool ok = true;
+    uint64_t seed = 1;
+    for (const CaseSpec &spec : CORPUS)
+        ok &= BenchCodec(MakeCase(spec, seed++), level);
+    ok &= BenchFullRange32();
+    Text("peak RSS %llu KB\n", (unsigned long long)PeakRssKB());
+
+    if (jsonOutput)
+        PrintJson(levelName);
+    return ok ? 0 : 1;
+}